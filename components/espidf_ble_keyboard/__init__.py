@@ -1,19 +1,172 @@
 import esphome.codegen as cg
 import esphome.config_validation as cv
-from esphome.const import CONF_ID
+from esphome import automation
+from esphome.const import CONF_ID, CONF_NAME, CONF_TX_POWER
+from .ble_keyboard_const import MAX_HOSTS
 
 DEPENDENCIES = ["esp32"]
 
 # Define the passkey configuration key
 CONF_PASSKEY = "passkey"
+CONF_MIN_REPORT_INTERVAL = "min_report_interval"
+CONF_KEYS_PER_REPORT = "keys_per_report"
+CONF_LAYOUT = "layout"
+CONF_PASTE_BUFFER_SIZE = "paste_buffer_size"
+CONF_LOW_LATENCY = "low_latency"
+CONF_INTERVAL = "interval"
+CONF_IDLE_INTERVAL = "idle_interval"
+CONF_IDLE_LATENCY = "idle_latency"
+CONF_IDLE_TIMEOUT = "idle_timeout"
+CONF_FAST_RECONNECT = "fast_reconnect"
+CONF_WHITELIST_DURATION = "whitelist_duration"
+CONF_HOST = "host"
+CONF_BROADCAST = "broadcast"
+CONF_TEXT = "text"
+CONF_KEY = "key"
+CONF_MODIFIER = "modifier"
+CONF_DURATION = "duration"
+CONF_COUNT = "count"
+CONF_RATE = "rate"
+CONF_REPORTS = "reports"
+CONF_ADVERTISING = "advertising"
+CONF_FAST_INTERVAL = "fast_interval"
+CONF_SLOW_INTERVAL = "slow_interval"
+CONF_FAST_DURATION = "fast_duration"
+CONF_ADV_DATA_ID = "adv_data_id"
+CONF_SCAN_RSP_DATA_ID = "scan_rsp_data_id"
 
 espidf_ble_keyboard_ns = cg.esphome_ns.namespace("espidf_ble_keyboard")
 EspidfBleKeyboard = espidf_ble_keyboard_ns.class_("EspidfBleKeyboard", cg.Component)
 
+SelectHostAction = espidf_ble_keyboard_ns.class_("SelectHostAction", automation.Action)
+NextHostAction = espidf_ble_keyboard_ns.class_("NextHostAction", automation.Action)
+SetBroadcastAction = espidf_ble_keyboard_ns.class_("SetBroadcastAction", automation.Action)
+SendStringAction = espidf_ble_keyboard_ns.class_("SendStringAction", automation.Action)
+PasteWriteAction = espidf_ble_keyboard_ns.class_("PasteWriteAction", automation.Action, cg.Component)
+PasteEndAction = espidf_ble_keyboard_ns.class_("PasteEndAction", automation.Action)
+PasteCancelAction = espidf_ble_keyboard_ns.class_("PasteCancelAction", automation.Action)
+PressKeyAction = espidf_ble_keyboard_ns.class_("PressKeyAction", automation.Action)
+ReleaseKeyAction = espidf_ble_keyboard_ns.class_("ReleaseKeyAction", automation.Action)
+ReleaseAllAction = espidf_ble_keyboard_ns.class_("ReleaseAllAction", automation.Action)
+HoldKeyAction = espidf_ble_keyboard_ns.class_("HoldKeyAction", automation.Action)
+RepeatKeyAction = espidf_ble_keyboard_ns.class_("RepeatKeyAction", automation.Action)
+AdvertiseFastAction = espidf_ble_keyboard_ns.class_("AdvertiseFastAction", automation.Action)
+RemoveAllBondsAction = espidf_ble_keyboard_ns.class_("RemoveAllBondsAction", automation.Action)
+
+def _conn_interval(min_us, max_us):
+    # BLE connection intervals are multiples of 1.25 ms
+    return cv.All(
+        cv.positive_time_period_microseconds,
+        cv.Range(min=cv.TimePeriod(microseconds=min_us), max=cv.TimePeriod(microseconds=max_us)),
+    )
+
+
+def _interval_units(period):
+    return int(round(period.total_microseconds / 1250))
+
+
+def validate_low_latency(config):
+    # Supervision timeout is fixed at 4 s; it must outlast (1 + latency) * interval * 2
+    idle_ms = config[CONF_IDLE_INTERVAL].total_microseconds / 1000
+    if (1 + config[CONF_IDLE_LATENCY]) * idle_ms * 2 >= 4000:
+        raise cv.Invalid(f"{CONF_IDLE_INTERVAL} x ({CONF_IDLE_LATENCY} + 1) must be below 2 s")
+    return config
+
+
+LOW_LATENCY_SCHEMA = cv.All(cv.Schema({
+    # Interval requested while reports are queued (7.5-15 ms)
+    cv.Optional(CONF_INTERVAL, default="7500us"): _conn_interval(7500, 15000),
+    # Power-saving interval and slave latency once typing has stopped
+    cv.Optional(CONF_IDLE_INTERVAL, default="45ms"): _conn_interval(7500, 4000000),
+    cv.Optional(CONF_IDLE_LATENCY, default=4): cv.int_range(min=0, max=499),
+    cv.Optional(CONF_IDLE_TIMEOUT, default="2s"): cv.positive_time_period_milliseconds,
+}), validate_low_latency)
+
+FAST_RECONNECT_SCHEMA = cv.Schema({
+    # How long only bonded hosts may connect before advertising opens up
+    cv.Optional(CONF_WHITELIST_DURATION, default="10s"): cv.positive_time_period_milliseconds,
+})
+
+def _adv_interval(period):
+    # Advertising intervals are multiples of 0.625 ms, 20 ms to 10.24 s
+    return int(round(period.total_microseconds / 625))
+
+
+ADV_INTERVAL = cv.All(
+    cv.positive_time_period_microseconds,
+    cv.Range(min=cv.TimePeriod(milliseconds=20), max=cv.TimePeriod(milliseconds=10240)),
+)
+
+# Advertising TX power levels common to all ESP32 variants (dBm)
+TX_POWER_LEVELS = {-12: "N12", -9: "N9", -6: "N6", -3: "N3", 0: "N0", 3: "P3", 6: "P6", 9: "P9"}
+
+
+def validate_tx_power(value):
+    value = cv.decibel(value)
+    if value not in TX_POWER_LEVELS:
+        raise cv.Invalid(f"TX power must be one of {', '.join(f'{p}dBm' for p in TX_POWER_LEVELS)}")
+    return int(value)
+
+
+def validate_device_name(value):
+    value = cv.string_strict(value)
+    # The name goes into the 31-byte scan response as a single AD structure
+    if not 0 < len(value.encode("utf-8")) <= 29:
+        raise cv.Invalid("Device name must be 1 to 29 bytes long")
+    return value
+
+
+ADVERTISING_SCHEMA = cv.Schema({
+    cv.Optional(CONF_NAME, default="ESP32 BLE Keyboard"): validate_device_name,
+    cv.Optional(CONF_TX_POWER): validate_tx_power,
+    cv.Optional(CONF_FAST_INTERVAL, default="20ms"): ADV_INTERVAL,
+    cv.Optional(CONF_SLOW_INTERVAL, default="1s"): ADV_INTERVAL,
+    # How long to advertise fast after boot or a disconnect; 0s = always fast
+    cv.Optional(CONF_FAST_DURATION, default="30s"): cv.positive_time_period_milliseconds,
+})
+
+
+def _advertising_payloads(conf):
+    adv = [0x02, 0x01, 0x06]  # Flags: LE General Discoverable, BR/EDR not supported
+    if CONF_TX_POWER in conf:
+        adv += [0x02, 0x0A, conf[CONF_TX_POWER] & 0xFF]  # TX Power Level
+    adv += [0x03, 0x19, 0xC1, 0x03]  # Appearance: HID Keyboard (0x03C1)
+    adv += [0x03, 0x03, 0x12, 0x18]  # Complete UUID16: HID service (0x1812)
+    name = list(conf[CONF_NAME].encode("utf-8"))
+    scan_rsp = [len(name) + 1, 0x09, *name]  # Complete Local Name
+    return adv, scan_rsp
+
+
+# Host keyboard layouts; each maps to a table in hid_keymap.h
+KEYBOARD_LAYOUTS = ["us", "de", "fr", "uk", "nordic"]
+
+# Optional HID reports; the keyboard report is always present. Each one
+# compiles its descriptor collection and GATT characteristic in or out.
+OPTIONAL_REPORTS = ["consumer", "system", "nkro", "mouse"]
+DEFAULT_REPORTS = ["consumer", "system", "nkro"]
+
 CONFIG_SCHEMA = cv.Schema({
     cv.GenerateID(): cv.declare_id(EspidfBleKeyboard),
     # Allow a 6-digit integer for the passkey
     cv.Optional(CONF_PASSKEY): cv.int_range(min=0, max=999999),
+    # Smallest gap between two HID notifications; the connection interval
+    # negotiated by the host is used instead when it is longer
+    cv.Optional(CONF_MIN_REPORT_INTERVAL, default="10ms"): cv.All(
+        cv.positive_time_period_milliseconds,
+        cv.Range(max=cv.TimePeriod(milliseconds=1000)),
+    ),
+    # Distinct keys typed per HID report; 1 sends every character on its own
+    cv.Optional(CONF_KEYS_PER_REPORT, default=6): cv.int_range(min=1, max=6),
+    # Layout the host is set to, so typed text comes out right
+    cv.Optional(CONF_LAYOUT, default="us"): cv.one_of(*KEYBOARD_LAYOUTS, lower=True),
+    # Ring buffer for paste_write(); allocated once, on first use
+    cv.Optional(CONF_PASTE_BUFFER_SIZE, default=512): cv.int_range(min=64, max=16384),
+    cv.Optional(CONF_LOW_LATENCY): LOW_LATENCY_SCHEMA,
+    cv.Optional(CONF_FAST_RECONNECT): FAST_RECONNECT_SCHEMA,
+    cv.Optional(CONF_ADVERTISING, default={}): ADVERTISING_SCHEMA,
+    cv.GenerateID(CONF_ADV_DATA_ID): cv.declare_id(cg.uint8),
+    cv.GenerateID(CONF_SCAN_RSP_DATA_ID): cv.declare_id(cg.uint8),
+    cv.Optional(CONF_REPORTS, default=DEFAULT_REPORTS): cv.ensure_list(cv.one_of(*OPTIONAL_REPORTS, lower=True)),
 }).extend(cv.COMPONENT_SCHEMA)
 
 async def to_code(config):
@@ -24,6 +177,43 @@ async def to_code(config):
     if CONF_PASSKEY in config:
         cg.add(var.set_passkey(config[CONF_PASSKEY]))
 
+    cg.add(var.set_min_report_interval(config[CONF_MIN_REPORT_INTERVAL].total_milliseconds))
+    cg.add(var.set_keys_per_report(config[CONF_KEYS_PER_REPORT]))
+    cg.add(var.set_paste_buffer_size(config[CONF_PASTE_BUFFER_SIZE]))
+    # Only the selected layout table is compiled in
+    cg.add_build_flag(f"-DESPIDF_BLE_KEYBOARD_LAYOUT_{config[CONF_LAYOUT].upper()}")
+    for report in OPTIONAL_REPORTS:
+        enabled = 1 if report in config[CONF_REPORTS] else 0
+        cg.add_build_flag(f"-DESPIDF_BLE_KEYBOARD_{report.upper()}={enabled}")
+
+    if CONF_LOW_LATENCY in config:
+        conf = config[CONF_LOW_LATENCY]
+        cg.add(var.set_low_latency(
+            _interval_units(conf[CONF_INTERVAL]),
+            _interval_units(conf[CONF_IDLE_INTERVAL]),
+            conf[CONF_IDLE_LATENCY],
+            conf[CONF_IDLE_TIMEOUT].total_milliseconds,
+        ))
+
+    # Advertising payloads are fixed at build time; nothing is patched on the device
+    adv_conf = config[CONF_ADVERTISING]
+    adv, scan_rsp = _advertising_payloads(adv_conf)
+    adv_data = cg.progmem_array(config[CONF_ADV_DATA_ID], adv)
+    scan_rsp_data = cg.progmem_array(config[CONF_SCAN_RSP_DATA_ID], scan_rsp)
+    cg.add(var.set_advertising_data(adv_data, len(adv), scan_rsp_data, len(scan_rsp)))
+    cg.add(var.set_device_name(adv_conf[CONF_NAME]))
+    if CONF_TX_POWER in adv_conf:
+        level = TX_POWER_LEVELS[adv_conf[CONF_TX_POWER]]
+        cg.add(var.set_tx_power(cg.RawExpression(f"ESP_PWR_LVL_{level}")))
+    cg.add(var.set_advertising_intervals(
+        _adv_interval(adv_conf[CONF_FAST_INTERVAL]),
+        _adv_interval(adv_conf[CONF_SLOW_INTERVAL]),
+        adv_conf[CONF_FAST_DURATION].total_milliseconds,
+    ))
+
+    if CONF_FAST_RECONNECT in config:
+        cg.add(var.set_fast_reconnect(config[CONF_FAST_RECONNECT][CONF_WHITELIST_DURATION].total_milliseconds))
+
     # Run after WiFi (priority -100)
     cg.add(var.set_setup_priority(-200))
 
@@ -32,4 +222,196 @@ async def to_code(config):
         include_builtin_idf_component("bt")
         include_builtin_idf_component("nvs_flash")
     except ImportError:
-        pass
\ No newline at end of file
+        pass
+
+
+# Host routing actions (see automation.h)
+KEYBOARD_ACTION_SCHEMA = cv.Schema({
+    cv.GenerateID(): cv.use_id(EspidfBleKeyboard),
+})
+HOST_SLOT = cv.int_range(min=0, max=MAX_HOSTS - 1)
+
+
+@automation.register_action(
+    "espidf_ble_keyboard.select_host",
+    SelectHostAction,
+    KEYBOARD_ACTION_SCHEMA.extend({
+        cv.Required(CONF_HOST): cv.templatable(HOST_SLOT),
+    }),
+)
+async def select_host_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    cg.add(var.set_host(await cg.templatable(config[CONF_HOST], args, cg.uint8)))
+    return var
+
+
+@automation.register_action(
+    "espidf_ble_keyboard.next_host",
+    NextHostAction,
+    automation.maybe_simple_id({cv.GenerateID(): cv.use_id(EspidfBleKeyboard)}),
+)
+async def next_host_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    return var
+
+
+@automation.register_action(
+    "espidf_ble_keyboard.set_broadcast",
+    SetBroadcastAction,
+    KEYBOARD_ACTION_SCHEMA.extend({
+        cv.Required(CONF_BROADCAST): cv.templatable(cv.boolean),
+    }),
+)
+async def set_broadcast_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    cg.add(var.set_broadcast(await cg.templatable(config[CONF_BROADCAST], args, bool)))
+    return var
+
+
+@automation.register_action(
+    "espidf_ble_keyboard.send_string",
+    SendStringAction,
+    KEYBOARD_ACTION_SCHEMA.extend({
+        cv.Required(CONF_TEXT): cv.templatable(cv.string),
+        # Type on this host slot only, without changing the selection
+        cv.Optional(CONF_HOST): cv.templatable(HOST_SLOT),
+    }),
+)
+async def send_string_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    cg.add(var.set_text(await cg.templatable(config[CONF_TEXT], args, cg.std_string)))
+    if CONF_HOST in config:
+        cg.add(var.set_host(await cg.templatable(config[CONF_HOST], args, cg.uint8)))
+    return var
+
+
+# Streaming paste: the next action runs once the whole chunk is buffered
+@automation.register_action(
+    "espidf_ble_keyboard.paste_write",
+    PasteWriteAction,
+    KEYBOARD_ACTION_SCHEMA.extend({
+        cv.Required(CONF_TEXT): cv.templatable(cv.string),
+    }),
+)
+async def paste_write_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_component(var, {})
+    await cg.register_parented(var, config[CONF_ID])
+    cg.add(var.set_text(await cg.templatable(config[CONF_TEXT], args, cg.std_string)))
+    return var
+
+
+@automation.register_action(
+    "espidf_ble_keyboard.paste_end",
+    PasteEndAction,
+    automation.maybe_simple_id({cv.GenerateID(): cv.use_id(EspidfBleKeyboard)}),
+)
+@automation.register_action(
+    "espidf_ble_keyboard.paste_cancel",
+    PasteCancelAction,
+    automation.maybe_simple_id({cv.GenerateID(): cv.use_id(EspidfBleKeyboard)}),
+)
+async def paste_control_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    return var
+
+
+# Key hold actions (NKRO report): HID usages 0x00-0x67 and modifiers 0xE0-0xE7
+def validate_nkro_key(value):
+    value = cv.hex_uint8_t(value)
+    if value > 0x67 and not 0xE0 <= value <= 0xE7:
+        raise cv.Invalid("Key must be a usage between 0x00 and 0x67, or a modifier 0xE0-0xE7")
+    return value
+
+
+KEY_ACTION_SCHEMA = KEYBOARD_ACTION_SCHEMA.extend({
+    cv.Required(CONF_KEY): cv.templatable(validate_nkro_key),
+})
+
+
+@automation.register_action("espidf_ble_keyboard.press", PressKeyAction, KEY_ACTION_SCHEMA)
+@automation.register_action("espidf_ble_keyboard.release", ReleaseKeyAction, KEY_ACTION_SCHEMA)
+async def key_action_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    cg.add(var.set_key(await cg.templatable(config[CONF_KEY], args, cg.uint8)))
+    return var
+
+
+@automation.register_action(
+    "espidf_ble_keyboard.release_all",
+    ReleaseAllAction,
+    automation.maybe_simple_id({cv.GenerateID(): cv.use_id(EspidfBleKeyboard)}),
+)
+async def release_all_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    return var
+
+
+@automation.register_action(
+    "espidf_ble_keyboard.hold",
+    HoldKeyAction,
+    KEYBOARD_ACTION_SCHEMA.extend({
+        cv.Optional(CONF_MODIFIER, default=0): cv.templatable(cv.hex_uint8_t),
+        # 0 holds just the modifiers
+        cv.Optional(CONF_KEY, default=0): cv.templatable(validate_nkro_key),
+        cv.Required(CONF_DURATION): cv.templatable(cv.positive_time_period_milliseconds),
+    }),
+)
+async def hold_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    cg.add(var.set_modifier(await cg.templatable(config[CONF_MODIFIER], args, cg.uint8)))
+    cg.add(var.set_key(await cg.templatable(config[CONF_KEY], args, cg.uint8)))
+    duration = config[CONF_DURATION]
+    if not cg.is_template(duration):
+        duration = duration.total_milliseconds
+    cg.add(var.set_duration(await cg.templatable(duration, args, cg.uint32)))
+    return var
+
+
+@automation.register_action(
+    "espidf_ble_keyboard.repeat",
+    RepeatKeyAction,
+    KEYBOARD_ACTION_SCHEMA.extend({
+        cv.Optional(CONF_MODIFIER, default=0): cv.templatable(cv.hex_uint8_t),
+        cv.Required(CONF_KEY): cv.templatable(cv.hex_uint8_t),
+        cv.Required(CONF_COUNT): cv.templatable(cv.int_range(min=1, max=65535)),
+        # Taps per second; each tap is a press and a release report
+        cv.Optional(CONF_RATE, default=10.0): cv.templatable(cv.float_range(min=0.1, max=50.0)),
+    }),
+)
+async def repeat_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    cg.add(var.set_modifier(await cg.templatable(config[CONF_MODIFIER], args, cg.uint8)))
+    cg.add(var.set_key(await cg.templatable(config[CONF_KEY], args, cg.uint8)))
+    cg.add(var.set_count(await cg.templatable(config[CONF_COUNT], args, cg.uint16)))
+    cg.add(var.set_rate(await cg.templatable(config[CONF_RATE], args, float)))
+    return var
+
+@automation.register_action(
+    "espidf_ble_keyboard.advertise_fast",
+    AdvertiseFastAction,
+    automation.maybe_simple_id({cv.GenerateID(): cv.use_id(EspidfBleKeyboard)}),
+)
+async def advertise_fast_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    return var
+
+@automation.register_action(
+    "espidf_ble_keyboard.remove_all_bonds",
+    RemoveAllBondsAction,
+    automation.maybe_simple_id({cv.GenerateID(): cv.use_id(EspidfBleKeyboard)}),
+)
+async def remove_all_bonds_to_code(config, action_id, template_arg, args):
+    var = cg.new_Pvariable(action_id, template_arg)
+    await cg.register_parented(var, config[CONF_ID])
+    return var
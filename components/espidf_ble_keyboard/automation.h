@@ -24,5 +24,150 @@ class SendCtrlAltDelTrigger : public Trigger<> {
   EspidfBleKeyboard *parent_;
 };
 
+// YAML actions for routing reports between connected hosts.
+
+template<typename... Ts> class SelectHostAction : public Action<Ts...>, public Parented<EspidfBleKeyboard> {
+ public:
+  TEMPLATABLE_VALUE(uint8_t, host)
+
+  void play(Ts... x) override { this->parent_->select_host(this->host_.value(x...)); }
+};
+
+template<typename... Ts> class NextHostAction : public Action<Ts...>, public Parented<EspidfBleKeyboard> {
+ public:
+  void play(Ts... x) override { this->parent_->select_next_host(); }
+};
+
+template<typename... Ts> class SetBroadcastAction : public Action<Ts...>, public Parented<EspidfBleKeyboard> {
+ public:
+  TEMPLATABLE_VALUE(bool, broadcast)
+
+  void play(Ts... x) override { this->parent_->set_broadcast(this->broadcast_.value(x...)); }
+};
+
+// Types text on the routed host(s), or on one host if `host` is set.
+template<typename... Ts> class SendStringAction : public Action<Ts...>, public Parented<EspidfBleKeyboard> {
+ public:
+  TEMPLATABLE_VALUE(std::string, text)
+  TEMPLATABLE_VALUE(uint8_t, host)
+
+  void play(Ts... x) override {
+    std::string text = this->text_.value(x...);
+    if (this->host_.has_value()) {
+      this->parent_->send_string_to(this->host_.value(x...), text);
+    } else {
+      this->parent_->send_string(text);
+    }
+  }
+};
+
+// Streaming paste. paste_write hands its text to the paste ring buffer; while
+// the buffer is full the rest is retried and the following actions wait, so a
+// script feeding chunks (e.g. from the API or a UART) gets backpressure.
+static const uint32_t PASTE_RETRY_MS = 20;
+
+template<typename... Ts>
+class PasteWriteAction : public Action<Ts...>, public Component, public Parented<EspidfBleKeyboard> {
+ public:
+  TEMPLATABLE_VALUE(std::string, text)
+
+  void play_complex(Ts... x) override {
+    this->num_running_++;
+    this->pending_ = this->text_.value(x...);
+    this->written_ = 0;
+    this->write_(x...);
+  }
+  void play(Ts... x) override { /* see play_complex */ }
+  void stop() override {
+    this->cancel_timeout("paste");
+    this->pending_.clear();
+  }
+
+ protected:
+  void write_(Ts... x) {
+    this->written_ += this->parent_->paste_write(this->pending_.data() + this->written_,
+                                                 this->pending_.size() - this->written_);
+    // Nothing is accepted without a connected host; don't wait for one
+    if (this->written_ < this->pending_.size() && this->parent_->is_connected()) {
+      this->set_timeout("paste", PASTE_RETRY_MS, [this, x...]() { this->write_(x...); });
+      return;
+    }
+    this->pending_.clear();
+    this->play_next_(x...);
+  }
+
+  std::string pending_;
+  size_t written_{0};
+};
+
+template<typename... Ts> class PasteEndAction : public Action<Ts...>, public Parented<EspidfBleKeyboard> {
+ public:
+  void play(Ts... x) override { this->parent_->paste_end(); }
+};
+
+template<typename... Ts> class PasteCancelAction : public Action<Ts...>, public Parented<EspidfBleKeyboard> {
+ public:
+  void play(Ts... x) override { this->parent_->paste_cancel(); }
+};
+
+// YAML actions for holding keys (NKRO report).
+
+template<typename... Ts> class PressKeyAction : public Action<Ts...>, public Parented<EspidfBleKeyboard> {
+ public:
+  TEMPLATABLE_VALUE(uint8_t, key)
+
+  void play(Ts... x) override { this->parent_->press(this->key_.value(x...)); }
+};
+
+template<typename... Ts> class ReleaseKeyAction : public Action<Ts...>, public Parented<EspidfBleKeyboard> {
+ public:
+  TEMPLATABLE_VALUE(uint8_t, key)
+
+  void play(Ts... x) override { this->parent_->release(this->key_.value(x...)); }
+};
+
+template<typename... Ts> class ReleaseAllAction : public Action<Ts...>, public Parented<EspidfBleKeyboard> {
+ public:
+  void play(Ts... x) override { this->parent_->release_all(); }
+};
+
+// Timed key actions; see EspidfBleKeyboard::hold() and repeat().
+
+template<typename... Ts> class HoldKeyAction : public Action<Ts...>, public Parented<EspidfBleKeyboard> {
+ public:
+  TEMPLATABLE_VALUE(uint8_t, modifier)
+  TEMPLATABLE_VALUE(uint8_t, key)
+  TEMPLATABLE_VALUE(uint32_t, duration)
+
+  void play(Ts... x) override {
+    this->parent_->hold(this->modifier_.value(x...), this->key_.value(x...), this->duration_.value(x...));
+  }
+};
+
+template<typename... Ts> class RepeatKeyAction : public Action<Ts...>, public Parented<EspidfBleKeyboard> {
+ public:
+  TEMPLATABLE_VALUE(uint8_t, modifier)
+  TEMPLATABLE_VALUE(uint8_t, key)
+  TEMPLATABLE_VALUE(uint16_t, count)
+  TEMPLATABLE_VALUE(float, rate)
+
+  void play(Ts... x) override {
+    this->parent_->repeat(this->key_.value(x...), this->count_.value(x...), this->rate_.value(x...),
+                          this->modifier_.value(x...));
+  }
+};
+
+// Restarts fast advertising (e.g. from a "Pair new PC" button).
+template<typename... Ts> class AdvertiseFastAction : public Action<Ts...>, public Parented<EspidfBleKeyboard> {
+ public:
+  void play(Ts... x) override { this->parent_->advertise_fast(); }
+};
+
+// Forgets every paired host; each has to pair (and enter the passkey) again.
+template<typename... Ts> class RemoveAllBondsAction : public Action<Ts...>, public Parented<EspidfBleKeyboard> {
+ public:
+  void play(Ts... x) override { this->parent_->remove_all_bonds(); }
+};
+
 }  // namespace espidf_ble_keyboard
 }  // namespace esphome
@@ -0,0 +1,22 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.components import binary_sensor
+from esphome.const import CONF_TYPE
+from . import EspidfBleKeyboard
+
+DEPENDENCIES = ["espidf_ble_keyboard"]
+
+CONF_KEYBOARD_ID = "keyboard_id"
+
+# Lock LEDs reported by the host through the keyboard output report
+LOCK_TYPES = ["num_lock", "caps_lock", "scroll_lock"]
+
+CONFIG_SCHEMA = binary_sensor.binary_sensor_schema().extend({
+    cv.Required(CONF_KEYBOARD_ID): cv.use_id(EspidfBleKeyboard),
+    cv.Required(CONF_TYPE): cv.one_of(*LOCK_TYPES, lower=True),
+})
+
+async def to_code(config):
+    var = await binary_sensor.new_binary_sensor(config)
+    parent = await cg.get_variable(config[CONF_KEYBOARD_ID])
+    cg.add(getattr(parent, f"set_{config[CONF_TYPE]}_binary_sensor")(var))
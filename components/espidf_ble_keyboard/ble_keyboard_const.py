@@ -1 +1,13 @@
 DOMAIN = "espidf_ble_keyboard"
+
+# Macro bytecode opcodes — must match MacroOp in macro.h
+MACRO_OP_TAP = 0x01
+MACRO_OP_PRESS = 0x02
+MACRO_OP_RELEASE = 0x03
+MACRO_OP_TYPE = 0x04
+MACRO_OP_DELAY = 0x05
+MACRO_OP_CONSUMER = 0x06
+MACRO_OP_SYSTEM = 0x07
+
+# Concurrent host connections — must match MAX_HOSTS in espidf_ble_keyboard.h
+MAX_HOSTS = 4
@@ -3,43 +3,171 @@ import esphome.config_validation as cv
 from esphome.components import button
 from esphome.const import CONF_ID
 from . import espidf_ble_keyboard_ns, EspidfBleKeyboard
+from .ble_keyboard_const import (
+    MACRO_OP_TAP,
+    MACRO_OP_PRESS,
+    MACRO_OP_RELEASE,
+    MACRO_OP_TYPE,
+    MACRO_OP_DELAY,
+    MACRO_OP_CONSUMER,
+    MACRO_OP_SYSTEM,
+)
 
 DEPENDENCIES = ["espidf_ble_keyboard"]
 
 EspidfBleKeyboardButton = espidf_ble_keyboard_ns.class_(
     "EspidfBleKeyboardButton", button.Button, cg.Component
 )
+ButtonActionType = espidf_ble_keyboard_ns.enum("ButtonActionType", is_class=True)
 
 CONF_ACTION = "action"
 CONF_KEYBOARD_ID = "keyboard_id"
+CONF_MACRO_ID = "macro_id"
+
+# Named string actions -> ButtonActionType
+NAMED_ACTIONS = {
+    "ctrl_alt_del": ButtonActionType.CTRL_ALT_DEL,
+    "sleep": ButtonActionType.SLEEP,
+    "shutdown": ButtonActionType.SHUTDOWN,
+    "hibernate": ButtonActionType.HIBERNATE,
+    "power": ButtonActionType.POWER,
+    "play_pause": ButtonActionType.PLAY_PAUSE,
+    "next_track": ButtonActionType.NEXT_TRACK,
+    "prev_track": ButtonActionType.PREV_TRACK,
+    "stop": ButtonActionType.STOP,
+    "volume_up": ButtonActionType.VOLUME_UP,
+    "volume_down": ButtonActionType.VOLUME_DOWN,
+    "mute": ButtonActionType.MUTE,
+}
+
+
+def _parse_int(value, max_value, what):
+    # Accept int or hex/decimal string
+    if isinstance(value, str):
+        try:
+            value = int(value, 0)
+        except ValueError as err:
+            raise cv.Invalid(f"Invalid {what} '{value}'") from err
+    if not isinstance(value, int) or not 0 <= value <= max_value:
+        raise cv.Invalid(f"{what} must be between 0 and {hex(max_value)}")
+    return value
 
 
+def _combo(mod, key):
+    return {
+        "type": "combo",
+        "modifier": _parse_int(mod, 0xFF, "modifier"),
+        "key": _parse_int(key, 0xFF, "key"),
+    }
+
+
+def _consumer(code):
+    return {"type": "consumer", "code": _parse_int(code, 0xFFFF, "consumer code")}
+
+
+def _key_operands(value):
+    # {modifier: .., key: ..} or "<modifier>:<key>"
+    if isinstance(value, str):
+        parts = value.split(":")
+        if len(parts) != 2:
+            raise cv.Invalid("Key format is '<modifier>:<key>'")
+        value = {"modifier": parts[0], "key": parts[1]}
+    if not isinstance(value, dict):
+        raise cv.Invalid("Expected a mapping with 'modifier' and 'key'")
+    combo = _combo(value.get("modifier", 0), value.get("key", 0))
+    return [combo["modifier"], combo["key"]]
+
+
+def _type_step(text):
+    # Text is split on character boundaries into chunks of at most 255 bytes
+    out, chunk = [], b""
+    for ch in cv.string(text):
+        encoded = ch.encode("utf-8")
+        if len(chunk) + len(encoded) > 255:
+            out += [MACRO_OP_TYPE, len(chunk), *chunk]
+            chunk = b""
+        chunk += encoded
+    if chunk:
+        out += [MACRO_OP_TYPE, len(chunk), *chunk]
+    return out
+
+
+def _macro_step(value):
+    if value == "release":
+        return [MACRO_OP_RELEASE]
+    if not isinstance(value, dict) or len(value) != 1:
+        raise cv.Invalid(
+            "Each macro step must be 'release' or a single key: "
+            "tap, press, type, delay, consumer or system"
+        )
+    ((kind, arg),) = value.items()
+    if kind == "tap":
+        return [MACRO_OP_TAP, *_key_operands(arg)]
+    if kind == "press":
+        return [MACRO_OP_PRESS, *_key_operands(arg)]
+    if kind == "type":
+        return _type_step(arg)
+    if kind == "delay":
+        ms = cv.positive_time_period_milliseconds(arg).total_milliseconds
+        if ms > 0xFFFF:
+            raise cv.Invalid("Macro delays are limited to 65535ms")
+        return [MACRO_OP_DELAY, ms & 0xFF, ms >> 8]
+    if kind == "consumer":
+        code = _consumer(arg)["code"]
+        return [MACRO_OP_CONSUMER, code & 0xFF, code >> 8]
+    if kind == "system":
+        return [MACRO_OP_SYSTEM, _parse_int(arg, 0xFF, "system usage")]
+    raise cv.Invalid(f"Unknown macro step '{kind}'")
+
+
+# Compiles macro steps into the flat bytecode played by EspidfBleKeyboard
+# (see macro.h), so nothing is parsed at trigger time.
+def _macro(steps):
+    if not isinstance(steps, list) or not steps:
+        raise cv.Invalid("A macro needs a non-empty list of 'steps'")
+    data = []
+    for i, step in enumerate(steps):
+        try:
+            data += _macro_step(step)
+        except cv.Invalid as err:
+            err.prepend(["steps", i])
+            raise
+    return {"type": "macro", "data": data}
+
+
+# Normalises every action form to a dict with a 'type' key, so to_code can
+# emit a typed action and nothing is parsed on the device.
 def validate_action(value):
     if isinstance(value, str):
-        return value
+        if value.startswith("combo:"):
+            parts = value.split(":")
+            if len(parts) != 3:
+                raise cv.Invalid("Combo format is 'combo:<modifier>:<key>'")
+            return _combo(parts[1], parts[2])
+        if value.startswith("consumer:"):
+            return _consumer(value[len("consumer:"):])
+        if value in NAMED_ACTIONS:
+            return {"type": "named", "name": value}
+        return {"type": "text", "text": value}
     if isinstance(value, dict):
         action_type = value.get("type", "")
         if action_type == "combo":
-            mod = value.get("modifier", 0)
-            key = value.get("key", 0)
-            # Accept int or hex string
-            if isinstance(mod, str):
-                mod = int(mod, 16) if mod.startswith("0x") else int(mod)
-            if isinstance(key, str):
-                key = int(key, 16) if key.startswith("0x") else int(key)
-            return f"combo:{hex(mod)}:{hex(key)}"
+            return _combo(value.get("modifier", 0), value.get("key", 0))
         elif action_type == "consumer":
-            code = value.get("code", 0)
-            if isinstance(code, str):
-                code = int(code, 16) if code.startswith("0x") else int(code)
-            return f"consumer:{hex(code)}"
-        raise cv.Invalid(f"Unknown action type '{action_type}'. Use 'combo' or 'consumer'.")
+            return _consumer(value.get("code", 0))
+        elif action_type == "macro":
+            return _macro(value.get("steps"))
+        elif action_type == "text":
+            # Types the text literally, even if it matches a named action
+            return {"type": "text", "text": cv.string(value.get("text", ""))}
+        raise cv.Invalid(f"Unknown action type '{action_type}'. Use 'combo', 'consumer', 'text' or 'macro'.")
     raise cv.Invalid("Action must be a string or a mapping with 'type' key.")
 
 
 CONFIG_SCHEMA = button.button_schema(EspidfBleKeyboardButton).extend({
     cv.Required(CONF_KEYBOARD_ID): cv.use_id(EspidfBleKeyboard),
     cv.Required(CONF_ACTION): validate_action,
+    cv.GenerateID(CONF_MACRO_ID): cv.declare_id(cg.uint8),
 }).extend(cv.COMPONENT_SCHEMA)
 
 async def to_code(config):
@@ -48,4 +176,16 @@ async def to_code(config):
 
     parent = await cg.get_variable(config[CONF_KEYBOARD_ID])
     cg.add(var.set_parent(parent))
-    cg.add(var.set_action(config[CONF_ACTION]))
\ No newline at end of file
+
+    action = config[CONF_ACTION]
+    if action["type"] == "combo":
+        cg.add(var.set_key_combo(action["modifier"], action["key"]))
+    elif action["type"] == "consumer":
+        cg.add(var.set_consumer(action["code"]))
+    elif action["type"] == "macro":
+        steps = cg.progmem_array(config[CONF_MACRO_ID], action["data"])
+        cg.add(var.set_macro(steps, len(action["data"])))
+    elif action["type"] == "named":
+        cg.add(var.set_action_type(NAMED_ACTIONS[action["name"]]))
+    else:
+        cg.add(var.set_text(action["text"]))
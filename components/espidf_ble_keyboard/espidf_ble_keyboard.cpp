@@ -4,12 +4,12 @@
 #include "espidf_ble_keyboard.h"
 #include "esphome/core/log.h"
 #include "esphome/core/hal.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
 #include "esp_gatt_defs.h"
 #include "esp_bt_defs.h"
+#include <algorithm>
+#include <cmath>
 #include <cstring>
-#include <cstdio>
+#include <memory>
 
 namespace esphome {
 namespace espidf_ble_keyboard {
@@ -18,10 +18,43 @@ static const char *TAG = "espidf_ble_keyboard";
 static EspidfBleKeyboard *s_instance = nullptr;
 #define GATTS_APP_ID 0x55
 
+// Give up waiting for ESP_GATTS_CONF_EVT after this long and resume sending
+static const uint32_t CONF_TIMEOUT_MS = 500;
+// Built-in macros (see macro.h for the bytecode format)
+static const uint8_t MACRO_CTRL_ALT_DEL[] = {
+    MACRO_OP_TAP, KEY_MOD_LCTRL | KEY_MOD_LALT, KEY_DELETE,
+};
+static const uint8_t MACRO_HIBERNATE[] = {
+    MACRO_OP_TAP, KEY_MOD_LGUI, KEY_R,  // Win + R to open Run dialog
+    MACRO_OP_DELAY, MACRO_U16(600),
+    MACRO_OP_TYPE, 11, 's', 'h', 'u', 't', 'd', 'o', 'w', 'n', ' ', '/', 'h',
+    MACRO_OP_DELAY, MACRO_U16(200),
+    MACRO_OP_TAP, 0, KEY_ENTER,
+};
+// HID System Sleep / Power Down — clean OS-level control, no lingering key state
+static const uint8_t MACRO_SYSTEM_SLEEP[] = {MACRO_OP_SYSTEM, 0x82};
+static const uint8_t MACRO_SYSTEM_POWER_DOWN[] = {MACRO_OP_SYSTEM, 0x81};
+
+// High duty cycle directed advertising must stop after 1.28 s
+static const uint32_t DIRECTED_ADV_MS = 1280;
+// A bonded host may rely on the subscriptions stored at bonding and never
+// write its CCCs again; after this long on a secure link, assume it is
+// subscribed to any report whose CCC it hasn't written in this connection
+static const uint32_t CCC_GRACE_MS = 1000;
+// How long a bonded host gets to encrypt the link itself before we ask
+static const uint32_t BOND_ENCRYPT_WAIT_MS = 1000;
+// Supervision timeout requested with every connection parameter update (10 ms units)
+static const uint16_t LINK_SUPERVISION_TIMEOUT = 400;
+
 // ── HID Report Descriptor ────────────────────────────────────────────────────
 // Report ID 1: Standard keyboard (8 bytes)
 // Report ID 2: Consumer control — power, media keys (2 bytes)
-static const uint8_t hid_report_map[] = {
+// Report ID 3: System control — power down, sleep (1 byte)
+// Report ID 4: NKRO keyboard — modifiers + key bitmap (14 bytes)
+// Report ID 5: Mouse — buttons, X, Y, wheel (4 bytes)
+// Only the report types selected with `reports:` are compiled in; a disabled
+// one costs no descriptor bytes, GATT handles or value buffers.
+static constexpr uint8_t hid_report_map[] = {
     // ---- Keyboard (Report ID 1) ----
     0x05, 0x01, 0x09, 0x06, 0xA1, 0x01,
     0x85, 0x01,
@@ -33,6 +66,7 @@ static const uint8_t hid_report_map[] = {
     0x95, 0x06, 0x75, 0x08, 0x15, 0x00, 0x25, 0x65,
     0x05, 0x07, 0x19, 0x00, 0x29, 0x65, 0x81, 0x00,
     0xC0,
+#if ESPIDF_BLE_KEYBOARD_CONSUMER
     // ---- Consumer Control (Report ID 2) — media keys ----
     0x05, 0x0C,        // Usage Page (Consumer)
     0x09, 0x01,        // Usage (Consumer Control)
@@ -46,6 +80,8 @@ static const uint8_t hid_report_map[] = {
     0x95, 0x01,        //   Report Count (1)
     0x81, 0x00,        //   Input (Data, Array)
     0xC0,              // End Collection
+#endif
+#if ESPIDF_BLE_KEYBOARD_SYSTEM
     // ---- System Control (Report ID 3) — power/sleep ----
     0x05, 0x01,        // Usage Page (Generic Desktop)
     0x09, 0x80,        // Usage (System Control)
@@ -58,24 +94,107 @@ static const uint8_t hid_report_map[] = {
     0x75, 0x08,        //   Report Size (8)
     0x95, 0x01,        //   Report Count (1)
     0x81, 0x00,        //   Input (Data, Array)
-    0xC0               // End Collection
+    0xC0,              // End Collection
+#endif
+#if ESPIDF_BLE_KEYBOARD_NKRO
+    // ---- NKRO Keyboard (Report ID 4) — one bit per key ----
+    0x05, 0x01,        // Usage Page (Generic Desktop)
+    0x09, 0x06,        // Usage (Keyboard)
+    0xA1, 0x01,        // Collection (Application)
+    0x85, 0x04,        //   Report ID (4)
+    0x05, 0x07,        //   Usage Page (Keyboard)
+    0x19, 0xE0,        //   Usage Minimum (Left Control)
+    0x29, 0xE7,        //   Usage Maximum (Right GUI)
+    0x15, 0x00,        //   Logical Minimum (0)
+    0x25, 0x01,        //   Logical Maximum (1)
+    0x75, 0x01,        //   Report Size (1)
+    0x95, 0x08,        //   Report Count (8)
+    0x81, 0x02,        //   Input (Data, Variable, Absolute)
+    0x19, 0x00,        //   Usage Minimum (0)
+    0x29, NKRO_MAX_KEY,      //   Usage Maximum (Keyboard =)
+    0x95, NKRO_MAX_KEY + 1,  //   Report Count (104)
+    0x81, 0x02,        //   Input (Data, Variable, Absolute)
+    0xC0,              // End Collection
+#endif
+#if ESPIDF_BLE_KEYBOARD_MOUSE
+    // ---- Mouse (Report ID 5) — relative X/Y and wheel ----
+    0x05, 0x01,        // Usage Page (Generic Desktop)
+    0x09, 0x02,        // Usage (Mouse)
+    0xA1, 0x01,        // Collection (Application)
+    0x85, 0x05,        //   Report ID (5)
+    0x09, 0x01,        //   Usage (Pointer)
+    0xA1, 0x00,        //   Collection (Physical)
+    0x05, 0x09,        //     Usage Page (Button)
+    0x19, 0x01,        //     Usage Minimum (1)
+    0x29, 0x03,        //     Usage Maximum (3)
+    0x15, 0x00,        //     Logical Minimum (0)
+    0x25, 0x01,        //     Logical Maximum (1)
+    0x75, 0x01,        //     Report Size (1)
+    0x95, 0x03,        //     Report Count (3)
+    0x81, 0x02,        //     Input (Data, Variable, Absolute)
+    0x75, 0x05,        //     Report Size (5)
+    0x95, 0x01,        //     Report Count (1)
+    0x81, 0x01,        //     Input (Constant) — padding
+    0x05, 0x01,        //     Usage Page (Generic Desktop)
+    0x09, 0x30,        //     Usage (X)
+    0x09, 0x31,        //     Usage (Y)
+    0x09, 0x38,        //     Usage (Wheel)
+    0x15, 0x81,        //     Logical Minimum (-127)
+    0x25, 0x7F,        //     Logical Maximum (127)
+    0x75, 0x08,        //     Report Size (8)
+    0x95, 0x03,        //     Report Count (3)
+    0x81, 0x06,        //     Input (Data, Variable, Relative)
+    0xC0,              //   End Collection
+    0xC0,              // End Collection
+#endif
 };
 
+// Walks the short items of a report descriptor: every item must fit, and
+// collections must nest and close. Counts Report ID items on the way.
+static constexpr int descriptor_report_ids(const uint8_t *map, size_t len) {
+    int depth = 0;
+    int ids = 0;
+    size_t i = 0;
+    while (i < len) {
+        uint8_t prefix = map[i];
+        size_t size = (prefix & 0x03) == 3 ? 4 : (prefix & 0x03);
+        if (prefix == 0xFE || i + 1 + size > len) return -1;  // long item or truncated
+        if ((prefix & 0xFC) == 0xA0) depth++;                 // Collection
+        if (prefix == 0xC0 && --depth < 0) return -1;         // End Collection
+        if (prefix == 0x85) ids++;                            // Report ID
+        i += 1 + size;
+    }
+    return depth == 0 ? ids : -1;
+}
+static_assert(descriptor_report_ids(hid_report_map, sizeof(hid_report_map)) ==
+                  1 + ESPIDF_BLE_KEYBOARD_CONSUMER + ESPIDF_BLE_KEYBOARD_SYSTEM + ESPIDF_BLE_KEYBOARD_NKRO +
+                      ESPIDF_BLE_KEYBOARD_MOUSE,
+              "hid_report_map is malformed or has a report without its Report ID");
+
 // ── Raw Advertising Data (Verified Working) ──────────────────────────────────
-static uint8_t raw_adv_data[] = {
+// Defaults only; codegen builds the payloads for the configured name and
+// TX power and passes them to set_advertising_data().
+static const uint8_t raw_adv_data[] = {
     0x02, 0x01, 0x06,           // Flags
     0x03, 0x19, 0xC1, 0x03,     // Appearance: HID Keyboard (0x03C1)
     0x03, 0x03, 0x12, 0x18      // Complete UUID16: HID service (0x1812)
 };
 
-static uint8_t raw_scan_rsp_data[] = {
+static const uint8_t raw_scan_rsp_data[] = {
     0x13, 0x09,                 // Local Name
     'E','S','P','3','2',' ','B','L','E',' ','K','e','y','b','o','a','r','d'
 };
 
+static const uint8_t *s_adv_data = raw_adv_data;
+static uint8_t s_adv_data_len = sizeof(raw_adv_data);
+static const uint8_t *s_scan_rsp_data = raw_scan_rsp_data;
+static uint8_t s_scan_rsp_data_len = sizeof(raw_scan_rsp_data);
+
+// Intervals are set from the advertising profile; only loop() changes them
+// once advertising has started.
 static esp_ble_adv_params_t adv_params = {
     .adv_int_min       = 0x20,
-    .adv_int_max       = 0x40,
+    .adv_int_max       = 0x20,
     .adv_type          = ADV_TYPE_IND,
     .own_addr_type     = BLE_ADDR_TYPE_PUBLIC,
     .peer_addr         = {0},
@@ -84,14 +203,20 @@ static esp_ble_adv_params_t adv_params = {
     .adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_ANY,
 };
 
+// The advertising payloads are configured once, while the attribute table is
+// still being created; advertising starts when both are set and the service
+// is running. Later restarts reuse the payloads the controller already has.
 static bool s_adv_data_set = false;
 static bool s_scan_rsp_data_set = false;
+static bool s_service_started = false;
+
+static void do_config_advertising_data() {
+    esp_ble_gap_config_adv_data_raw(const_cast<uint8_t *>(s_adv_data), s_adv_data_len);
+    esp_ble_gap_config_scan_rsp_data_raw(const_cast<uint8_t *>(s_scan_rsp_data), s_scan_rsp_data_len);
+}
 
 static void do_start_advertising() {
-    s_adv_data_set = false;
-    s_scan_rsp_data_set = false;
-    esp_ble_gap_config_adv_data_raw(raw_adv_data, sizeof(raw_adv_data));
-    esp_ble_gap_config_scan_rsp_data_raw(raw_scan_rsp_data, sizeof(raw_scan_rsp_data));
+    if (s_adv_data_set && s_scan_rsp_data_set && s_service_started) esp_ble_gap_start_advertising(&adv_params);
 }
 
 // ── GAP Event Handler ────────────────────────────────────────────────────────
@@ -99,11 +224,33 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
     switch (event) {
         case ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT:
             s_adv_data_set = true;
-            if (s_scan_rsp_data_set) esp_ble_gap_start_advertising(&adv_params);
+            do_start_advertising();
             break;
         case ESP_GAP_BLE_SCAN_RSP_DATA_RAW_SET_COMPLETE_EVT:
             s_scan_rsp_data_set = true;
-            if (s_adv_data_set) esp_ble_gap_start_advertising(&adv_params);
+            do_start_advertising();
+            break;
+        case ESP_GAP_BLE_ADV_START_COMPLETE_EVT:
+            if (param->adv_start_cmpl.status != ESP_BT_STATUS_SUCCESS) {
+                ESP_LOGW(TAG, "GAP: Starting advertising failed (0x%x)", param->adv_start_cmpl.status);
+            } else if (s_instance) {
+                s_instance->on_advertising_started();
+            }
+            break;
+        case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT: {
+            const auto &p = param->update_conn_params;
+            if (p.status != ESP_BT_STATUS_SUCCESS) {
+                ESP_LOGW(TAG, "GAP: Connection parameter update failed (0x%x)", p.status);
+                break;
+            }
+            ESP_LOGI(TAG, "GAP: Link interval %.2f ms, slave latency %u, supervision timeout %u ms",
+                     p.conn_int * 1.25f, p.latency, p.timeout * 10);
+            if (s_instance) s_instance->set_conn_interval(p.bda, p.conn_int);
+            break;
+        }
+        case ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT:
+            if (s_instance && param->read_rssi_cmpl.status == ESP_BT_STATUS_SUCCESS)
+                s_instance->set_rssi(param->read_rssi_cmpl.rssi);
             break;
         case ESP_GAP_BLE_SEC_REQ_EVT:
             esp_ble_gap_security_rsp(param->ble_security.ble_req.bd_addr, true);
@@ -114,6 +261,11 @@ static void gap_event_handler(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param
             } else {
                 ESP_LOGE(TAG, "GAP: Pairing Failed (0x%x)", param->ble_security.auth_cmpl.fail_reason);
             }
+            if (s_instance) {
+                s_instance->on_auth_complete(param->ble_security.auth_cmpl.bd_addr,
+                                             param->ble_security.auth_cmpl.success,
+                                             param->ble_security.auth_cmpl.auth_mode);
+            }
             break;
         default:
             break;
@@ -131,22 +283,56 @@ enum {
     IDX_CHAR_REPORT,       IDX_CHAR_REPORT_VAL,
     IDX_CHAR_REPORT_CCC,
     IDX_CHAR_REPORT_REF,
+    // Keyboard LED output report (Report ID 1)
+    IDX_CHAR_LED_OUT,      IDX_CHAR_LED_OUT_VAL,
+    IDX_CHAR_LED_OUT_REF,
+    // Boot keyboard input/output reports (boot protocol mode)
+    IDX_CHAR_BOOT_IN,      IDX_CHAR_BOOT_IN_VAL,
+    IDX_CHAR_BOOT_IN_CCC,
+    IDX_CHAR_BOOT_OUT,     IDX_CHAR_BOOT_OUT_VAL,
+#if ESPIDF_BLE_KEYBOARD_CONSUMER
     // Consumer control report (Report ID 2)
     IDX_CHAR_CONSUMER,     IDX_CHAR_CONSUMER_VAL,
     IDX_CHAR_CONSUMER_CCC,
     IDX_CHAR_CONSUMER_REF,
+#endif
+#if ESPIDF_BLE_KEYBOARD_SYSTEM
     // System control report (Report ID 3)
     IDX_CHAR_SYSTEM,       IDX_CHAR_SYSTEM_VAL,
     IDX_CHAR_SYSTEM_CCC,
     IDX_CHAR_SYSTEM_REF,
+#endif
+#if ESPIDF_BLE_KEYBOARD_NKRO
+    // NKRO keyboard report (Report ID 4)
+    IDX_CHAR_NKRO,         IDX_CHAR_NKRO_VAL,
+    IDX_CHAR_NKRO_CCC,
+    IDX_CHAR_NKRO_REF,
+#endif
+#if ESPIDF_BLE_KEYBOARD_MOUSE
+    // Mouse report (Report ID 5)
+    IDX_CHAR_MOUSE,        IDX_CHAR_MOUSE_VAL,
+    IDX_CHAR_MOUSE_CCC,
+    IDX_CHAR_MOUSE_REF,
+#endif
     HID_IDX_NB,
 };
 
 static uint16_t hid_handle_table[HID_IDX_NB];
 static esp_gatt_if_t s_gatts_if = ESP_GATT_IF_NONE;
 static uint16_t s_hid_report_handle = 0;
+static uint16_t s_boot_input_handle = 0;
+#if ESPIDF_BLE_KEYBOARD_CONSUMER
 static uint16_t s_consumer_report_handle = 0;
+#endif
+#if ESPIDF_BLE_KEYBOARD_SYSTEM
 static uint16_t s_system_report_handle = 0;
+#endif
+#if ESPIDF_BLE_KEYBOARD_NKRO
+static uint16_t s_nkro_report_handle = 0;
+#endif
+#if ESPIDF_BLE_KEYBOARD_MOUSE
+static uint16_t s_mouse_report_handle = 0;
+#endif
 
 static uint8_t  hid_info_val[4]   = {0x11, 0x01, 0x00, 0x01};
 static uint8_t  hid_ctrl_val      = 0;
@@ -154,12 +340,31 @@ static uint8_t  proto_mode_val    = 0x01;
 static uint8_t  report_val[8]     = {0};
 static uint16_t report_ccc_val    = 0;
 static uint8_t  report_ref_val[2]     = {0x01, 0x01};
+static uint8_t  led_out_val           = 0;
+static uint8_t  led_out_ref_val[2]    = {0x01, 0x02};
+static uint8_t  boot_in_val[8]        = {0};
+static uint16_t boot_in_ccc_val       = 0;
+static uint8_t  boot_out_val          = 0;
+#if ESPIDF_BLE_KEYBOARD_CONSUMER
 static uint8_t  consumer_val[2]       = {0};
 static uint16_t consumer_ccc_val      = 0;
 static uint8_t  consumer_ref_val[2]   = {0x02, 0x01};
+#endif
+#if ESPIDF_BLE_KEYBOARD_SYSTEM
 static uint8_t  system_val            = 0;
 static uint16_t system_ccc_val        = 0;
 static uint8_t  system_ref_val[2]     = {0x03, 0x01};
+#endif
+#if ESPIDF_BLE_KEYBOARD_NKRO
+static uint8_t  nkro_val[NKRO_REPORT_LEN] = {0};
+static uint16_t nkro_ccc_val          = 0;
+static uint8_t  nkro_ref_val[2]       = {0x04, 0x01};
+#endif
+#if ESPIDF_BLE_KEYBOARD_MOUSE
+static uint8_t  mouse_val[MOUSE_REPORT_LEN] = {0};
+static uint16_t mouse_ccc_val         = 0;
+static uint8_t  mouse_ref_val[2]      = {0x05, 0x01};
+#endif
 
 static const uint16_t UUID_PRI_SERVICE        = ESP_GATT_UUID_PRI_SERVICE;
 static const uint16_t UUID_HID_SVC            = ESP_GATT_UUID_HID_SVC;
@@ -169,6 +374,8 @@ static const uint16_t UUID_HID_REPORT_MAP     = ESP_GATT_UUID_HID_REPORT_MAP;
 static const uint16_t UUID_HID_CONTROL_POINT  = ESP_GATT_UUID_HID_CONTROL_POINT;
 static const uint16_t UUID_HID_PROTO_MODE     = ESP_GATT_UUID_HID_PROTO_MODE;
 static const uint16_t UUID_HID_REPORT         = ESP_GATT_UUID_HID_REPORT;
+static const uint16_t UUID_HID_BOOT_KB_INPUT  = ESP_GATT_UUID_HID_BT_KB_INPUT;
+static const uint16_t UUID_HID_BOOT_KB_OUTPUT = ESP_GATT_UUID_HID_BT_KB_OUTPUT;
 static const uint16_t UUID_CHAR_CLIENT_CONFIG = ESP_GATT_UUID_CHAR_CLIENT_CONFIG;
 static const uint16_t UUID_RPT_REF_DESCR      = ESP_GATT_UUID_RPT_REF_DESCR;
 
@@ -176,6 +383,7 @@ static const uint8_t PROP_READ        = ESP_GATT_CHAR_PROP_BIT_READ;
 static const uint8_t PROP_WRITE_NR    = ESP_GATT_CHAR_PROP_BIT_WRITE_NR;
 static const uint8_t PROP_RW_NR       = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE_NR;
 static const uint8_t PROP_READ_NOTIFY = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_NOTIFY;
+static const uint8_t PROP_READ_WRITE  = ESP_GATT_CHAR_PROP_BIT_READ | ESP_GATT_CHAR_PROP_BIT_WRITE | ESP_GATT_CHAR_PROP_BIT_WRITE_NR;
 
 static const esp_gatts_attr_db_t hid_attr_db[HID_IDX_NB] = {
     [IDX_SVC] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_PRI_SERVICE, ESP_GATT_PERM_READ, sizeof(uint16_t), sizeof(uint16_t), (uint8_t *)&UUID_HID_SVC}},
@@ -191,16 +399,44 @@ static const esp_gatts_attr_db_t hid_attr_db[HID_IDX_NB] = {
     [IDX_CHAR_REPORT_VAL] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_HID_REPORT, ESP_GATT_PERM_READ, sizeof(report_val), sizeof(report_val), report_val}},
     [IDX_CHAR_REPORT_CCC] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_CHAR_CLIENT_CONFIG, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(report_ccc_val), sizeof(report_ccc_val), (uint8_t *)&report_ccc_val}},
     [IDX_CHAR_REPORT_REF] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_RPT_REF_DESCR, ESP_GATT_PERM_READ, sizeof(report_ref_val), sizeof(report_ref_val), report_ref_val}},
+    // Keyboard LED output report (Report ID 1)
+    [IDX_CHAR_LED_OUT] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_CHAR_DECLARE, ESP_GATT_PERM_READ, 1, 1, (uint8_t *)&PROP_READ_WRITE}},
+    [IDX_CHAR_LED_OUT_VAL] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_HID_REPORT, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(led_out_val), sizeof(led_out_val), &led_out_val}},
+    [IDX_CHAR_LED_OUT_REF] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_RPT_REF_DESCR, ESP_GATT_PERM_READ, sizeof(led_out_ref_val), sizeof(led_out_ref_val), led_out_ref_val}},
+    // Boot keyboard input/output reports (same 8-byte / LED layout as Report ID 1)
+    [IDX_CHAR_BOOT_IN] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_CHAR_DECLARE, ESP_GATT_PERM_READ, 1, 1, (uint8_t *)&PROP_READ_NOTIFY}},
+    [IDX_CHAR_BOOT_IN_VAL] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_HID_BOOT_KB_INPUT, ESP_GATT_PERM_READ, sizeof(boot_in_val), sizeof(boot_in_val), boot_in_val}},
+    [IDX_CHAR_BOOT_IN_CCC] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_CHAR_CLIENT_CONFIG, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(boot_in_ccc_val), sizeof(boot_in_ccc_val), (uint8_t *)&boot_in_ccc_val}},
+    [IDX_CHAR_BOOT_OUT] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_CHAR_DECLARE, ESP_GATT_PERM_READ, 1, 1, (uint8_t *)&PROP_READ_WRITE}},
+    [IDX_CHAR_BOOT_OUT_VAL] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_HID_BOOT_KB_OUTPUT, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(boot_out_val), sizeof(boot_out_val), &boot_out_val}},
+#if ESPIDF_BLE_KEYBOARD_CONSUMER
     // Consumer control report (Report ID 2)
     [IDX_CHAR_CONSUMER] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_CHAR_DECLARE, ESP_GATT_PERM_READ, 1, 1, (uint8_t *)&PROP_READ_NOTIFY}},
     [IDX_CHAR_CONSUMER_VAL] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_HID_REPORT, ESP_GATT_PERM_READ, sizeof(consumer_val), sizeof(consumer_val), consumer_val}},
     [IDX_CHAR_CONSUMER_CCC] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_CHAR_CLIENT_CONFIG, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(consumer_ccc_val), sizeof(consumer_ccc_val), (uint8_t *)&consumer_ccc_val}},
     [IDX_CHAR_CONSUMER_REF] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_RPT_REF_DESCR, ESP_GATT_PERM_READ, sizeof(consumer_ref_val), sizeof(consumer_ref_val), consumer_ref_val}},
+#endif
+#if ESPIDF_BLE_KEYBOARD_SYSTEM
     // System control report (Report ID 3)
     [IDX_CHAR_SYSTEM] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_CHAR_DECLARE, ESP_GATT_PERM_READ, 1, 1, (uint8_t *)&PROP_READ_NOTIFY}},
     [IDX_CHAR_SYSTEM_VAL] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_HID_REPORT, ESP_GATT_PERM_READ, sizeof(system_val), sizeof(system_val), &system_val}},
     [IDX_CHAR_SYSTEM_CCC] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_CHAR_CLIENT_CONFIG, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(system_ccc_val), sizeof(system_ccc_val), (uint8_t *)&system_ccc_val}},
     [IDX_CHAR_SYSTEM_REF] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_RPT_REF_DESCR, ESP_GATT_PERM_READ, sizeof(system_ref_val), sizeof(system_ref_val), system_ref_val}},
+#endif
+#if ESPIDF_BLE_KEYBOARD_NKRO
+    // NKRO keyboard report (Report ID 4)
+    [IDX_CHAR_NKRO] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_CHAR_DECLARE, ESP_GATT_PERM_READ, 1, 1, (uint8_t *)&PROP_READ_NOTIFY}},
+    [IDX_CHAR_NKRO_VAL] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_HID_REPORT, ESP_GATT_PERM_READ, sizeof(nkro_val), sizeof(nkro_val), nkro_val}},
+    [IDX_CHAR_NKRO_CCC] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_CHAR_CLIENT_CONFIG, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(nkro_ccc_val), sizeof(nkro_ccc_val), (uint8_t *)&nkro_ccc_val}},
+    [IDX_CHAR_NKRO_REF] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_RPT_REF_DESCR, ESP_GATT_PERM_READ, sizeof(nkro_ref_val), sizeof(nkro_ref_val), nkro_ref_val}},
+#endif
+#if ESPIDF_BLE_KEYBOARD_MOUSE
+    // Mouse report (Report ID 5)
+    [IDX_CHAR_MOUSE] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_CHAR_DECLARE, ESP_GATT_PERM_READ, 1, 1, (uint8_t *)&PROP_READ_NOTIFY}},
+    [IDX_CHAR_MOUSE_VAL] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_HID_REPORT, ESP_GATT_PERM_READ, sizeof(mouse_val), sizeof(mouse_val), mouse_val}},
+    [IDX_CHAR_MOUSE_CCC] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_CHAR_CLIENT_CONFIG, ESP_GATT_PERM_READ | ESP_GATT_PERM_WRITE, sizeof(mouse_ccc_val), sizeof(mouse_ccc_val), (uint8_t *)&mouse_ccc_val}},
+    [IDX_CHAR_MOUSE_REF] = {{ESP_GATT_AUTO_RSP}, {ESP_UUID_LEN_16, (uint8_t *)&UUID_RPT_REF_DESCR, ESP_GATT_PERM_READ, sizeof(mouse_ref_val), sizeof(mouse_ref_val), mouse_ref_val}},
+#endif
 };
 
 // ── GATTS Event Handler ──────────────────────────────────────────────────────
@@ -208,30 +444,93 @@ static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_
     switch (event) {
         case ESP_GATTS_REG_EVT:
             s_gatts_if = gatts_if;
-            esp_ble_gap_set_device_name("ESP32 BLE Keyboard");
+            esp_ble_gap_set_device_name(s_instance ? s_instance->device_name().c_str() : "ESP32 BLE Keyboard");
+            do_config_advertising_data();
             esp_ble_gatts_create_attr_tab(hid_attr_db, gatts_if, HID_IDX_NB, 0);
             break;
         case ESP_GATTS_CREAT_ATTR_TAB_EVT:
             memcpy(hid_handle_table, param->add_attr_tab.handles, sizeof(hid_handle_table));
             s_hid_report_handle = hid_handle_table[IDX_CHAR_REPORT_VAL];
+            s_boot_input_handle = hid_handle_table[IDX_CHAR_BOOT_IN_VAL];
+#if ESPIDF_BLE_KEYBOARD_CONSUMER
             s_consumer_report_handle = hid_handle_table[IDX_CHAR_CONSUMER_VAL];
+#endif
+#if ESPIDF_BLE_KEYBOARD_SYSTEM
             s_system_report_handle = hid_handle_table[IDX_CHAR_SYSTEM_VAL];
+#endif
+#if ESPIDF_BLE_KEYBOARD_NKRO
+            s_nkro_report_handle = hid_handle_table[IDX_CHAR_NKRO_VAL];
+#endif
+#if ESPIDF_BLE_KEYBOARD_MOUSE
+            s_mouse_report_handle = hid_handle_table[IDX_CHAR_MOUSE_VAL];
+#endif
             esp_ble_gatts_start_service(hid_handle_table[IDX_SVC]);
             break;
         case ESP_GATTS_START_EVT:
+            s_service_started = true;
             do_start_advertising();
             break;
         case ESP_GATTS_CONNECT_EVT:
-            if (s_instance) s_instance->set_connected(true, param->connect.conn_id);
-            // If passkey is used, trigger security
-            if (s_instance && s_instance->has_passkey()) {
-                esp_ble_set_encryption(param->connect.remote_bda, ESP_BLE_SEC_ENCRYPT_MITM);
+            if (!s_instance) break;
+            if (!s_instance->on_connect(param->connect.conn_id, param->connect.remote_bda,
+                                        param->connect.conn_params.interval)) {
+                ESP_LOGW(TAG, "All %u host slots in use, rejecting connection", MAX_HOSTS);
+                esp_ble_gap_disconnect(param->connect.remote_bda);
+                break;
             }
+            // Advertising stops on connect; keep it up while more hosts fit
+            if (s_instance->connected_hosts() < MAX_HOSTS) s_instance->request_advertising(false);
             break;
         case ESP_GATTS_DISCONNECT_EVT:
-            if (s_instance) s_instance->set_connected(false, 0);
-            esp_ble_gap_start_advertising(&adv_params);
+            if (!s_instance) break;
+            s_instance->on_disconnect(param->disconnect.conn_id);
+            // loop() restarts advertising at the fast interval, or runs the
+            // fast reconnect sequence
+            s_instance->request_advertising(true);
+            break;
+        case ESP_GATTS_CONF_EVT:
+            if (s_instance) s_instance->on_notification_confirmed(param->conf.conn_id, param->conf.status == ESP_GATT_OK);
+            break;
+        case ESP_GATTS_CONGEST_EVT:
+            if (s_instance) s_instance->on_congestion(param->congest.conn_id, param->congest.congested);
+            break;
+        case ESP_GATTS_MTU_EVT:
+            if (s_instance) s_instance->set_mtu(param->mtu.conn_id, param->mtu.mtu);
+            break;
+        case ESP_GATTS_WRITE_EVT: {
+            // The stack stores the value and responds (AUTO_RSP). Bluedroid keeps
+            // one value per attribute, so LEDs and subscriptions are tracked per host here.
+            if (!s_instance || param->write.len < 1) break;
+            uint16_t handle = param->write.handle;
+            uint16_t conn_id = param->write.conn_id;
+            bool notify = param->write.value[0] & 0x01;
+            if (handle == hid_handle_table[IDX_CHAR_LED_OUT_VAL] || handle == hid_handle_table[IDX_CHAR_BOOT_OUT_VAL]) {
+                s_instance->set_led_state(conn_id, param->write.value[0]);
+            } else if (handle == hid_handle_table[IDX_CHAR_REPORT_CCC]) {
+                s_instance->on_subscription(conn_id, CCC_KEYBOARD, notify);
+            } else if (handle == hid_handle_table[IDX_CHAR_BOOT_IN_CCC]) {
+                s_instance->on_subscription(conn_id, CCC_BOOT_KEYBOARD, notify);
+#if ESPIDF_BLE_KEYBOARD_CONSUMER
+            } else if (handle == hid_handle_table[IDX_CHAR_CONSUMER_CCC]) {
+                s_instance->on_subscription(conn_id, CCC_CONSUMER, notify);
+#endif
+#if ESPIDF_BLE_KEYBOARD_SYSTEM
+            } else if (handle == hid_handle_table[IDX_CHAR_SYSTEM_CCC]) {
+                s_instance->on_subscription(conn_id, CCC_SYSTEM, notify);
+#endif
+#if ESPIDF_BLE_KEYBOARD_NKRO
+            } else if (handle == hid_handle_table[IDX_CHAR_NKRO_CCC]) {
+                s_instance->on_subscription(conn_id, CCC_NKRO, notify);
+#endif
+#if ESPIDF_BLE_KEYBOARD_MOUSE
+            } else if (handle == hid_handle_table[IDX_CHAR_MOUSE_CCC]) {
+                s_instance->on_subscription(conn_id, CCC_MOUSE, notify);
+#endif
+            } else if (handle == hid_handle_table[IDX_CHAR_PROTO_MODE_VAL]) {
+                s_instance->on_protocol_mode(conn_id, param->write.value[0]);
+            }
             break;
+        }
         default:
             break;
     }
@@ -240,18 +539,89 @@ static void gatts_event_handler(esp_gatts_cb_event_t event, esp_gatt_if_t gatts_
 // ── Component Setup ─────────────────────────────────────────────────────────
 void EspidfBleKeyboard::setup() {
     s_instance = this;
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        nvs_flash_erase();
-        nvs_flash_init();
-    }
-    
-    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
-    esp_bt_controller_init(&bt_cfg);
-    esp_bt_controller_enable(ESP_BT_MODE_BLE);
-    esp_bluedroid_init();
-    esp_bluedroid_enable();
+    // The Bluetooth stack is brought up from loop(), see advance_startup_()
+    this->startup_begin_ms_ = millis();
+    this->set_adv_interval_(true);
+}
+
+static const char *startup_step_name(BtStartup step) {
+    switch (step) {
+        case BtStartup::NVS:         return "NVS";
+        case BtStartup::CONTROLLER:  return "controller";
+        case BtStartup::BLUEDROID:   return "Bluedroid";
+        case BtStartup::GATT:        return "GATT";
+        case BtStartup::ADVERTISING: return "advertising";
+        default:                     return "done";
+    }
+}
 
+// One blocking stack call group per loop(), so Wi-Fi, the API and the other
+// components keep running between them instead of waiting for the whole
+// bring-up (roughly 300-500 ms) inside setup().
+void EspidfBleKeyboard::advance_startup_() {
+    BtStartup step = this->startup_step_;
+    if (step == BtStartup::ADVERTISING) {
+        uint32_t adv_ms = this->advertising_ms_;
+        if (adv_ms == 0) return;
+        ESP_LOGI(TAG, "Advertising (connectable) %u ms after boot, %u ms after Bluetooth startup began",
+                 (unsigned) adv_ms, (unsigned) (adv_ms - this->startup_begin_ms_));
+        this->startup_step_ = BtStartup::DONE;
+        return;
+    }
+
+    uint32_t start = millis();
+    esp_err_t err = ESP_OK;
+    switch (step) {
+        case BtStartup::NVS:
+            err = nvs_flash_init();
+            if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+                nvs_flash_erase();
+                err = nvs_flash_init();
+            }
+            if (err == ESP_OK) this->load_bonds_();
+            // BLE only: give the Classic BT controller memory back to the heap.
+            // Fails harmlessly if another component already released it.
+            if (err == ESP_OK && esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT) != ESP_OK)
+                ESP_LOGD(TAG, "Classic BT memory already released");
+            break;
+        case BtStartup::CONTROLLER: {
+            esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+            err = esp_bt_controller_init(&bt_cfg);
+            if (err == ESP_OK) err = esp_bt_controller_enable(ESP_BT_MODE_BLE);
+            break;
+        }
+        case BtStartup::BLUEDROID:
+            err = esp_bluedroid_init();
+            if (err == ESP_OK) err = esp_bluedroid_enable();
+            break;
+        case BtStartup::GATT:
+            this->start_gatt_();
+            break;
+        default:
+            return;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Bluetooth startup failed at %s: %s", startup_step_name(step), esp_err_to_name(err));
+        this->mark_failed();
+        return;
+    }
+    ESP_LOGD(TAG, "Startup: %s took %u ms", startup_step_name(step), (unsigned) (millis() - start));
+    this->startup_step_ = static_cast<BtStartup>(static_cast<uint8_t>(step) + 1);
+}
+
+void EspidfBleKeyboard::on_advertising_started() {
+    // Only the first start is of interest (time to connectable)
+    uint32_t expected = 0;
+    this->advertising_ms_.compare_exchange_strong(expected, millis());
+}
+
+void EspidfBleKeyboard::start_gatt_() {
+    // Bluedroid is up and has loaded its bonds; drop cache entries it forgot
+    this->sync_bonds_();
+    if (this->has_tx_power_) {
+        esp_err_t err = esp_ble_tx_power_set(ESP_BLE_PWR_TYPE_ADV, this->tx_power_);
+        if (err != ESP_OK) ESP_LOGW(TAG, "Setting advertising TX power failed: %s", esp_err_to_name(err));
+    }
     if (this->has_passkey_) {
         ESP_LOGI(TAG, "Setting passkey in setup: %06d", this->passkey_);
         esp_ble_gap_set_security_param(ESP_BLE_SM_SET_STATIC_PASSKEY, &this->passkey_, sizeof(uint32_t));
@@ -274,102 +644,1298 @@ void EspidfBleKeyboard::setup() {
     esp_ble_gatts_app_register(GATTS_APP_ID);
 }
 
-void EspidfBleKeyboard::loop() {}
+void EspidfBleKeyboard::dump_config() {
+    ESP_LOGCONFIG(TAG, "ESP-IDF BLE Keyboard:");
+    ESP_LOGCONFIG(TAG, "  Passkey: %s", YESNO(this->has_passkey_));
+    ESP_LOGCONFIG(TAG, "  Min report interval: %u ms", this->min_report_interval_ms_);
+    ESP_LOGCONFIG(TAG, "  Report queue size: %u", (unsigned) REPORT_QUEUE_SIZE);
+    ESP_LOGCONFIG(TAG, "  Layout: %s", LAYOUT_NAME);
+    ESP_LOGCONFIG(TAG, "  Keys per report: %u", this->packer_.keys_per_report());
+    ESP_LOGCONFIG(TAG, "  Paste buffer: %u bytes", (unsigned) this->paste_size_);
+    ESP_LOGCONFIG(TAG, "  Host slots: %u", MAX_HOSTS);
+    ESP_LOGCONFIG(TAG, "  Reports: keyboard%s%s%s%s (%u GATT attributes)",
+                  ESPIDF_BLE_KEYBOARD_CONSUMER ? ", consumer" : "", ESPIDF_BLE_KEYBOARD_SYSTEM ? ", system" : "",
+                  ESPIDF_BLE_KEYBOARD_NKRO ? ", nkro" : "", ESPIDF_BLE_KEYBOARD_MOUSE ? ", mouse" : "",
+                  (unsigned) HID_IDX_NB);
+    ESP_LOGCONFIG(TAG, "  Device name: %s", this->device_name_.c_str());
+    if (this->has_passkey_) {
+        ESP_LOGCONFIG(TAG, "  Bonds: %u", this->bond_count_);
+        for (uint8_t i = 0; i < this->bond_count_; i++) {
+            const BondInfo &b = this->bonds_[i];
+            ESP_LOGCONFIG(TAG, "    %02X:%02X:%02X:%02X:%02X:%02X (%s, %.2f ms)", b.bda[0], b.bda[1], b.bda[2],
+                          b.bda[3], b.bda[4], b.bda[5], (b.auth_mode & ESP_LE_AUTH_REQ_MITM) ? "MITM" : "unauthenticated",
+                          b.conn_interval * 1.25f);
+        }
+    }
+    if (this->adv_fast_duration_ms_ > 0) {
+        ESP_LOGCONFIG(TAG, "  Advertising: %.1f ms for %u ms, then %.1f ms", this->adv_fast_interval_ * 0.625f,
+                      (unsigned) this->adv_fast_duration_ms_, this->adv_slow_interval_ * 0.625f);
+    } else {
+        ESP_LOGCONFIG(TAG, "  Advertising: %.1f ms", this->adv_fast_interval_ * 0.625f);
+    }
+    if (this->fast_reconnect_) {
+        ESP_LOGCONFIG(TAG, "  Fast reconnect: directed, then bonded hosts only for %u ms",
+                      (unsigned) this->whitelist_ms_);
+    }
+    if (this->low_latency_) {
+        ESP_LOGCONFIG(TAG, "  Low latency: %.2f ms while typing, %.2f ms (latency %u) after %u ms idle",
+                      this->fast_interval_ * 1.25f, this->idle_interval_ * 1.25f, this->idle_latency_,
+                      (unsigned) this->idle_timeout_ms_);
+    }
+#ifdef USE_SENSOR
+    LOG_SENSOR("  ", "Notifications sent", this->notifications_sent_sensor_);
+    LOG_SENSOR("  ", "Notifications failed", this->notifications_failed_sensor_);
+    LOG_SENSOR("  ", "Notifications dropped", this->notifications_dropped_sensor_);
+    LOG_SENSOR("  ", "Congestion events", this->congestion_events_sensor_);
+    LOG_SENSOR("  ", "Queue high water", this->queue_high_water_sensor_);
+    LOG_SENSOR("  ", "Latency p50", this->latency_p50_sensor_);
+    LOG_SENSOR("  ", "Latency p95", this->latency_p95_sensor_);
+    LOG_SENSOR("  ", "Connection interval", this->conn_interval_sensor_);
+    LOG_SENSOR("  ", "MTU", this->mtu_sensor_);
+    LOG_SENSOR("  ", "RSSI", this->rssi_sensor_);
+#endif
+}
 
-void EspidfBleKeyboard::send_string(const std::string &str) {
-    if (!is_connected_) return;
-    uint8_t report[8] = {0};
-    for (char c : str) {
-        report[0] = 0; report[2] = 0;
-        if      (c >= 'a' && c <= 'z') { report[2] = (uint8_t)(c - 'a' + 0x04); }
-        else if (c >= 'A' && c <= 'Z') { report[0] = 0x02; report[2] = (uint8_t)(c - 'A' + 0x04); }
-        else if (c >= '1' && c <= '9') { report[2] = (uint8_t)(c - '1' + 0x1E); }
-        else if (c == '0') { report[2] = 0x27; }
-        else if (c == ' ')  { report[2] = 0x2C; }
-        else if (c == '\n') { report[2] = 0x28; }
-        else if (c == '.')  { report[2] = 0x37; }
-        else if (c == ',')  { report[2] = 0x36; }
-        else if (c == '/')  { report[2] = 0x38; }
-        else if (c == '\\') { report[2] = 0x31; }
-        else if (c == '-')  { report[2] = 0x2D; }
-        else if (c == '=')  { report[2] = 0x2E; }
-        else if (c == ';')  { report[2] = 0x33; }
-        else if (c == '\'') { report[2] = 0x34; }
-        else if (c == '_')  { report[0] = 0x02; report[2] = 0x2D; }
-        else if (c == '+')  { report[0] = 0x02; report[2] = 0x2E; }
-        else if (c == ':')  { report[0] = 0x02; report[2] = 0x33; }
-        else continue;
-
-        esp_ble_gatts_send_indicate(s_gatts_if, conn_id_, s_hid_report_handle, 8, report, false);
-        vTaskDelay(pdMS_TO_TICKS(20));
-        memset(report, 0, 8);
-        esp_ble_gatts_send_indicate(s_gatts_if, conn_id_, s_hid_report_handle, 8, report, false);
-        vTaskDelay(pdMS_TO_TICKS(20));
+// ── Report Queue ─────────────────────────────────────────────────────────────
+// send_* calls only enqueue; loop() sends the next report once the link is
+// ready for it. Pacing follows the connection interval (one report per
+// connection event, never faster than min_report_interval) and backs off while
+// Bluedroid reports congestion or earlier notifications are unconfirmed.
+void EspidfBleKeyboard::loop() {
+    if (startup_step_ != BtStartup::DONE) {
+        advance_startup_();
+        // Nothing can be connected before advertising has started
+        if (startup_step_ != BtStartup::ADVERTISING && startup_step_ != BtStartup::DONE) return;
+    }
+    publish_leds_();
+#ifdef USE_SENSOR
+    publish_telemetry_();
+#endif
+    // A connect ends the reconnect sequence first, so a pending advertising
+    // restart for the remaining slots isn't held back by it
+    if (fast_reconnect_) advance_reconnect_();
+    advance_advertising_();
+    rehome_hosts_();
+    update_bonds_();
+    uint8_t connected = connected_mask_();
+    if (connected == 0) {
+        if (queue_count_ > 0) clear_queue_();
+        memset(key_state_, 0, sizeof(key_state_));
+        memset(hold_refs_, 0, sizeof(hold_refs_));
+        key_state_dirty_ = false;
+        timed_epoch_++;
+        macro_count_ = 0;
+        pending_text_.clear();
+        if (paste_active_) reset_paste_();
+        return;
+    }
+    if (low_latency_) update_link_mode_();
+    // Ahead of macros and pastes, which would take the free slots
+    if (key_state_dirty_) send_key_state_();
+    // Text and macros share packer_, so one waits for the other
+    if (!pending_text_.empty()) {
+        advance_text_();
+    } else if (macro_count_ > 0) {
+        advance_macro_();
+    } else if (paste_active_) {
+        advance_paste_();
+    }
+    uint32_t now = millis();
+    check_ready_hosts_(now);
+    if (queue_count_ == 0) return;
+    if (burst_remaining_ == 0 && now - last_report_ms_ < next_gap_ms_) return;
+
+    // A broadcast report goes out to each of its hosts as they become ready;
+    // it leaves the queue once every host still connected has it.
+    const QueuedReport &report = queue_[queue_tail_];
+    uint8_t pending = 0;
+    if (report.target != ReportTarget::NONE) pending = report.hosts & connected & ~report_sent_mask_;
+    bool attempted = false, failed = false;
+    for (uint8_t i = 0; i < MAX_HOSTS; i++) {
+        if (!(pending & (1 << i)) || !host_accepts_(hosts_[i], report.target, now) || !host_ready_(hosts_[i], now))
+            continue;
+        attempted = true;
+        if (send_report_(report, hosts_[i])) {
+            report_sent_mask_ |= 1 << i;
+            if (hosts_[i].first_report_pending) {
+                hosts_[i].first_report_pending = false;
+                ESP_LOGI(TAG, "Host %u: first report sent %u ms after connecting", i,
+                         (unsigned) (now - hosts_[i].connected_ms));
+            }
+        } else {
+            failed = true;
+        }
+    }
+    pending &= ~report_sent_mask_;
+    if (attempted) last_report_ms_ = now;
+    if (failed) {
+        notifications_retried_++;
+        next_gap_ms_ = report_gap_ms_(pending);
+        if (++send_attempts_ < MAX_SEND_RETRIES) return;
+        notifications_dropped_++;
+        ESP_LOGW(TAG, "Dropping report after %u failed attempts", MAX_SEND_RETRIES);
+    } else if (pending != 0) {
+        return;  // Waiting for a congested or not yet subscribed host
+    }
+    send_attempts_ = 0;
+    report_sent_mask_ = 0;
+    last_report_ms_ = now;
+    if (report.target == ReportTarget::NONE) {
+        next_gap_ms_ = report.delay_ms;
+    } else {
+        next_gap_ms_ = std::max(report_gap_ms_(report.hosts), report.delay_ms);
+    }
+    queue_tail_ = (queue_tail_ + 1) % REPORT_QUEUE_SIZE;
+    queue_count_--;
+    if (burst_remaining_ > 0) burst_remaining_--;
+    if (queue_count_ == 0) high_freq_.stop();
+}
+
+// ── Link Mode ────────────────────────────────────────────────────────────────
+// Hosts that reports are queued for get the fast interval; each drops back
+// once nothing has been sent for idle_timeout.
+void EspidfBleKeyboard::update_link_mode_() {
+    fast_hosts_ &= connected_mask_();
+    uint8_t busy = queue_count_ > 0 ? route_mask_() : 0;
+    bool idle = millis() - last_report_ms_ >= idle_timeout_ms_;
+    for (uint8_t i = 0; i < MAX_HOSTS; i++) {
+        uint8_t bit = 1 << i;
+        if ((busy & bit) && !(fast_hosts_ & bit)) {
+            fast_hosts_ |= bit;
+            request_conn_params_(hosts_[i], fast_interval_, 0);
+        } else if (!(busy & bit) && (fast_hosts_ & bit) && idle) {
+            fast_hosts_ &= ~bit;
+            request_conn_params_(hosts_[i], idle_interval_, idle_latency_);
+        }
+    }
+}
+
+void EspidfBleKeyboard::request_conn_params_(const HostLink &host, uint16_t interval, uint16_t latency) {
+    esp_ble_conn_update_params_t params = {};
+    memcpy(params.bda, host.bda, sizeof(esp_bd_addr_t));
+    params.min_int = interval;
+    params.max_int = interval;
+    params.latency = latency;
+    params.timeout = LINK_SUPERVISION_TIMEOUT;
+    esp_err_t err = esp_ble_gap_update_conn_params(&params);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Connection parameter request failed: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGD(TAG, "Requesting %.2f ms interval, slave latency %u", interval * 1.25f, latency);
+    }
+}
+
+// ── Fast Reconnect ───────────────────────────────────────────────────────────
+// A waking host reconnects fastest to directed advertising, so that comes
+// first; whitelist advertising then still lets any bonded host back in
+// without strangers racing it, and open advertising is the last resort.
+// Phases are timed from loop(); any new connection ends the sequence.
+static const char *adv_phase_name(AdvPhase phase) {
+    switch (phase) {
+        case AdvPhase::DIRECTED:  return "directed";
+        case AdvPhase::WHITELIST: return "whitelist";
+        case AdvPhase::OPEN:      return "open";
+        default:                  return "none";
+    }
+}
+
+void EspidfBleKeyboard::advance_reconnect_() {
+    if (reconnect_pending_.exchange(false)) {
+        phase_connect_count_ = connect_count_;
+        start_reconnect_phase_(AdvPhase::DIRECTED);
+        return;
+    }
+    if (adv_phase_ == AdvPhase::OFF) return;
+    if (connect_count_ != phase_connect_count_) {
+        ESP_LOGI(TAG, "Reconnected %u ms after disconnect (%s advertising)",
+                 (unsigned) (millis() - disconnect_ms_), adv_phase_name(adv_phase_));
+        adv_phase_ = AdvPhase::OFF;
+        return;
+    }
+    uint32_t elapsed = millis() - adv_phase_ms_;
+    if (adv_phase_ == AdvPhase::DIRECTED && elapsed >= DIRECTED_ADV_MS) {
+        start_reconnect_phase_(AdvPhase::WHITELIST);
+    } else if (adv_phase_ == AdvPhase::WHITELIST && elapsed >= whitelist_ms_) {
+        start_reconnect_phase_(AdvPhase::OPEN);
+    }
+}
+
+void EspidfBleKeyboard::start_reconnect_phase_(AdvPhase phase) {
+    int count = esp_ble_get_bond_device_num();
+    std::unique_ptr<esp_ble_bond_dev_t[]> bonded;
+    if (phase != AdvPhase::OPEN && count > 0) {
+        bonded.reset(new esp_ble_bond_dev_t[count]);
+        if (esp_ble_get_bond_device_list(&count, bonded.get()) != ESP_OK) count = 0;
+    } else {
+        count = 0;
+    }
+
+    esp_ble_adv_params_t params = adv_params;
+    if (phase == AdvPhase::DIRECTED) {
+        // Only a bonded host can be expected to answer directed advertising
+        int match = -1;
+        for (int i = 0; i < count && match < 0; i++) {
+            if (memcmp(bonded[i].bd_addr, last_host_bda_, sizeof(esp_bd_addr_t)) == 0) match = i;
+        }
+        if (match < 0) {
+            phase = AdvPhase::WHITELIST;
+        } else {
+            params.adv_type = ADV_TYPE_DIRECT_IND_HIGH;
+            memcpy(params.peer_addr, bonded[match].bd_addr, sizeof(esp_bd_addr_t));
+            params.peer_addr_type = bonded[match].bd_addr_type;
+        }
+    }
+    if (phase == AdvPhase::WHITELIST) {
+        if (count == 0) {
+            phase = AdvPhase::OPEN;
+        } else {
+            esp_ble_gap_clear_whitelist();
+            for (int i = 0; i < count; i++) {
+                esp_ble_gap_update_whitelist(true, bonded[i].bd_addr,
+                                             bonded[i].bd_addr_type == BLE_ADDR_TYPE_RANDOM ? BLE_WL_ADDR_TYPE_RANDOM
+                                                                                            : BLE_WL_ADDR_TYPE_PUBLIC);
+            }
+            params.adv_filter_policy = ADV_FILTER_ALLOW_SCAN_ANY_CON_WLST;
+        }
+    }
+
+    // Bluedroid runs these in order. Other hosts may still be connected with
+    // open advertising running, so always stop it first.
+    esp_ble_gap_stop_advertising();
+    esp_err_t err = esp_ble_gap_start_advertising(&params);
+    if (err != ESP_OK) ESP_LOGW(TAG, "Starting advertising failed: %s", esp_err_to_name(err));
+    ESP_LOGD(TAG, "Reconnect: %s advertising", adv_phase_name(phase));
+    adv_phase_ = phase;
+    adv_phase_ms_ = millis();
+}
+
+// ── Bond Cache ───────────────────────────────────────────────────────────────
+// Owned by loop(): loaded before the Bluedroid callbacks are registered,
+// updated from flags the Bluedroid task raises on its HostLink.
+static const char *const BOND_NVS_NAMESPACE = "ble_keyboard";
+static const char *const BOND_NVS_KEY = "bonds";
+
+void EspidfBleKeyboard::load_bonds_() {
+    nvs_handle_t handle;
+    if (nvs_open(BOND_NVS_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) return;  // Nothing saved yet
+    size_t size = sizeof(bonds_);
+    esp_err_t err = nvs_get_blob(handle, BOND_NVS_KEY, bonds_, &size);
+    nvs_close(handle);
+    if (err != ESP_OK || size % sizeof(BondInfo) != 0) {
+        if (err != ESP_ERR_NVS_NOT_FOUND) ESP_LOGW(TAG, "Ignoring unreadable bond cache");
+        bond_count_ = 0;
+        return;
+    }
+    bond_count_ = size / sizeof(BondInfo);
+}
+
+void EspidfBleKeyboard::sync_bonds_() {
+    int count = esp_ble_get_bond_device_num();
+    std::unique_ptr<esp_ble_bond_dev_t[]> bonded;
+    if (count > 0) {
+        bonded.reset(new esp_ble_bond_dev_t[count]);
+        if (esp_ble_get_bond_device_list(&count, bonded.get()) != ESP_OK) return;  // Keep the cache as is
+    }
+    bool changed = false;
+    for (int i = bond_count_ - 1; i >= 0; i--) {
+        bool found = false;
+        for (int j = 0; j < count && !found; j++) found = memcmp(bonded[j].bd_addr, bonds_[i].bda, sizeof(esp_bd_addr_t)) == 0;
+        if (!found) {
+            erase_bond_(i);
+            changed = true;
+        }
+    }
+    // Hosts bonded before the cache existed; their details fill in on reconnect
+    for (int j = 0; j < count && bond_count_ < MAX_BONDS; j++) {
+        if (find_bond_(bonded[j].bd_addr) >= 0) continue;
+        bonds_[bond_count_] = BondInfo{};
+        memcpy(bonds_[bond_count_++].bda, bonded[j].bd_addr, sizeof(esp_bd_addr_t));
+        changed = true;
+    }
+    if (changed) save_bonds_();
+    // The most recent hosts get their slots back
+    for (uint8_t i = 0; i < bond_count_ && i < MAX_HOSTS; i++) {
+        memcpy(hosts_[i].bda, bonds_[i].bda, sizeof(esp_bd_addr_t));
+        memcpy(hosts_[i].identity, bonds_[i].bda, sizeof(esp_bd_addr_t));
+        hosts_[i].known = true;
+    }
+    ESP_LOGD(TAG, "Bond cache: %u hosts (%d bonded in Bluedroid)", bond_count_, count);
+}
+
+void EspidfBleKeyboard::save_bonds_() {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(BOND_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, BOND_NVS_KEY, bonds_, bond_count_ * sizeof(BondInfo));
+        if (err == ESP_OK) err = nvs_commit(handle);
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) ESP_LOGW(TAG, "Saving bond cache failed: %s", esp_err_to_name(err));
+}
+
+int EspidfBleKeyboard::find_bond_(const uint8_t *bda) const {
+    for (int i = 0; i < bond_count_; i++) {
+        if (memcmp(bonds_[i].bda, bda, sizeof(esp_bd_addr_t)) == 0) return i;
+    }
+    return -1;
+}
+
+bool EspidfBleKeyboard::bond_expected_(const uint8_t *bda) const {
+    int index = find_bond_(bda);
+    if (index >= 0) return bonds_[index].auth_mode & ESP_LE_AUTH_REQ_MITM;
+    // A resolvable private address (top bits 01) can't be looked up before
+    // the link is encrypted; it may well belong to one of the bonded hosts
+    if ((bda[0] & 0xC0) != 0x40) return false;
+    for (uint8_t i = 0; i < bond_count_; i++) {
+        if (bonds_[i].auth_mode & ESP_LE_AUTH_REQ_MITM) return true;
+    }
+    return false;
+}
+
+// Moves the host to the front of the cache; the oldest entry makes room.
+// True if anything changed.
+bool EspidfBleKeyboard::store_bond_(const HostLink &host) {
+    BondInfo info{};
+    memcpy(info.bda, host.identity, sizeof(esp_bd_addr_t));
+    info.auth_mode = host.auth_mode;
+    info.subscribed = host.subscribed;
+    info.conn_interval = host.conn_interval;
+    int index = find_bond_(host.identity);
+    if (index == 0 && memcmp(&bonds_[0], &info, sizeof(info)) == 0) return false;
+    if (index < 0) index = bond_count_ < MAX_BONDS ? bond_count_++ : MAX_BONDS - 1;
+    memmove(&bonds_[1], &bonds_[0], index * sizeof(BondInfo));
+    bonds_[0] = info;
+    return true;
+}
+
+void EspidfBleKeyboard::erase_bond_(int index) {
+    memmove(&bonds_[index], &bonds_[index + 1], (bond_count_ - index - 1) * sizeof(BondInfo));
+    bond_count_--;
+}
+
+void EspidfBleKeyboard::update_bonds_() {
+    uint32_t now = millis();
+    bool changed = false;
+    for (auto &host : hosts_) {
+        if (!host.connected) continue;
+        if (host.encrypted && !host.bond_checked) {
+            // Now the identity is known: a bonded host gets the subscriptions
+            // stored at bonding back, unless it has written them again already
+            host.bond_checked = true;
+            int index = find_bond_(host.identity);
+            host.bonded = index >= 0;
+            if (host.bonded) host.subscribed |= bonds_[index].subscribed & ~host.ccc_written;
+        }
+        if (host.security_pending) {
+            if (host.secured) {
+                host.security_pending = false;
+                ESP_LOGD(TAG, "Bonded host encrypted the link itself after %u ms",
+                         (unsigned) (host.secured_ms - host.connected_ms));
+            } else if (!bond_expected_(host.bda) || now - host.connected_ms >= BOND_ENCRYPT_WAIT_MS) {
+                // New host, or a known one that didn't encrypt: ask for it
+                host.security_pending = false;
+                esp_ble_set_encryption(host.bda, ESP_BLE_SEC_ENCRYPT_MITM);
+            }
+        }
+        if (host.bond_dirty.exchange(false)) changed |= store_bond_(host);
     }
+    if (changed) save_bonds_();
+}
+
+bool EspidfBleKeyboard::remove_bond(const uint8_t *bda) {
+    esp_bd_addr_t addr;
+    memcpy(addr, bda, sizeof(addr));
+    bool removed = esp_ble_remove_bond_device(addr) == ESP_OK;
+    int index = find_bond_(bda);
+    if (index >= 0) {
+        erase_bond_(index);
+        save_bonds_();
+        removed = true;
+    }
+    for (auto &host : hosts_) {
+        if (host.connected || !host.known) continue;
+        if (memcmp(host.bda, bda, sizeof(esp_bd_addr_t)) == 0 || memcmp(host.identity, bda, sizeof(esp_bd_addr_t)) == 0) {
+            host.known = false;
+            host.subscribed = 0;
+        }
+    }
+    return removed;
+}
+
+void EspidfBleKeyboard::remove_all_bonds() {
+    int count = esp_ble_get_bond_device_num();
+    if (count > 0) {
+        std::unique_ptr<esp_ble_bond_dev_t[]> bonded(new esp_ble_bond_dev_t[count]);
+        if (esp_ble_get_bond_device_list(&count, bonded.get()) == ESP_OK) {
+            for (int i = 0; i < count; i++) esp_ble_remove_bond_device(bonded[i].bd_addr);
+        }
+    }
+    bond_count_ = 0;
+    save_bonds_();
+    for (auto &host : hosts_) {
+        if (host.connected) continue;
+        host.known = false;
+        host.subscribed = 0;
+    }
+    ESP_LOGI(TAG, "Removed all bonds (%d)", count);
+}
+
+// ── Advertising Profile ──────────────────────────────────────────────────────
+void EspidfBleKeyboard::set_advertising_data(const uint8_t *adv, uint8_t adv_len, const uint8_t *scan_rsp,
+                                             uint8_t scan_rsp_len) {
+    s_adv_data = adv;
+    s_adv_data_len = adv_len;
+    s_scan_rsp_data = scan_rsp;
+    s_scan_rsp_data_len = scan_rsp_len;
+}
+
+void EspidfBleKeyboard::set_adv_interval_(bool fast) {
+    uint16_t interval = fast ? adv_fast_interval_ : adv_slow_interval_;
+    adv_params.adv_int_min = interval;
+    adv_params.adv_int_max = interval;
+    adv_slow_ = !fast;
+    if (fast) adv_fast_since_ms_ = millis();
+}
+
+bool EspidfBleKeyboard::restart_advertising_() {
+    // The reconnect sequence picks the new interval up with its next phase;
+    // before the service has started, the first start uses it anyway
+    if (adv_phase_ == AdvPhase::DIRECTED || adv_phase_ == AdvPhase::WHITELIST) return false;
+    if (!s_service_started || connected_hosts() >= MAX_HOSTS) return true;
+    esp_ble_gap_stop_advertising();
+    esp_err_t err = esp_ble_gap_start_advertising(&adv_params);
+    if (err != ESP_OK) ESP_LOGW(TAG, "Starting advertising failed: %s", esp_err_to_name(err));
+    return true;
+}
+
+void EspidfBleKeyboard::advertise_fast() {
+    set_adv_interval_(true);
+    restart_advertising_();
+    ESP_LOGD(TAG, "Advertising: fast (%.1f ms)", adv_fast_interval_ * 0.625f);
+}
+
+void EspidfBleKeyboard::advance_advertising_() {
+    // Keep a resume request until the reconnect sequence has ended, so the
+    // remaining slots get open advertising back
+    if (adv_resume_pending_.exchange(false) && !restart_advertising_()) adv_resume_pending_ = true;
+    if (adv_burst_pending_.exchange(false)) {
+        set_adv_interval_(true);
+        // With fast reconnect, advance_reconnect_() starts advertising
+        if (!fast_reconnect_) restart_advertising_();
+        return;
+    }
+    if (!adv_slow_ && adv_fast_duration_ms_ > 0 && millis() - adv_fast_since_ms_ >= adv_fast_duration_ms_) {
+        set_adv_interval_(false);
+        restart_advertising_();
+        ESP_LOGD(TAG, "Advertising: slow (%.1f ms)", adv_slow_interval_ * 0.625f);
+    }
+}
+
+uint16_t EspidfBleKeyboard::report_gap_ms_(uint8_t hosts) const {
+    // Pace for the slowest host; connection intervals are in 1.25 ms units,
+    // rounded up to whole milliseconds
+    uint16_t gap = min_report_interval_ms_;
+    for (uint8_t i = 0; i < MAX_HOSTS; i++) {
+        if (hosts & (1 << i)) gap = std::max(gap, (uint16_t) ((hosts_[i].conn_interval * 5 + 3) / 4));
+    }
+    return gap;
+}
+
+bool EspidfBleKeyboard::host_ready_(HostLink &host, uint32_t now) {
+    if (host.congested) return false;
+    if (host.in_flight >= (burst_remaining_ > 0 ? BURST_MAX_IN_FLIGHT : MAX_IN_FLIGHT)) {
+        if (now - host.in_flight_since_ms < CONF_TIMEOUT_MS) return false;
+        // A confirmation went missing — don't stall the queue forever
+        host.in_flight = 0;
+        host.conf_seq = host.send_seq.load();
+    }
+    return true;
+}
+
+static uint8_t ccc_bit(ReportTarget target, bool boot_protocol) {
+    switch (target) {
+        case ReportTarget::KEYBOARD: return boot_protocol ? CCC_BOOT_KEYBOARD : CCC_KEYBOARD;
+        case ReportTarget::CONSUMER: return CCC_CONSUMER;
+        case ReportTarget::SYSTEM:   return CCC_SYSTEM;
+        case ReportTarget::NKRO:     return boot_protocol ? CCC_BOOT_KEYBOARD : CCC_NKRO;
+        case ReportTarget::MOUSE:    return CCC_MOUSE;
+        default:                     return 0;
+    }
+}
+
+bool EspidfBleKeyboard::host_accepts_(const HostLink &host, ReportTarget target, uint32_t now) const {
+    if (!host.secured) return false;
+    // send_report_ skips these for a boot host, which never subscribes to
+    // them; waiting for their CCC would hold up the queue for good
+    if (host.boot_protocol && (target == ReportTarget::CONSUMER || target == ReportTarget::SYSTEM ||
+                               target == ReportTarget::MOUSE))
+        return true;
+    uint8_t bit = ccc_bit(target, host.boot_protocol);
+    if (host.subscribed & bit) return true;
+    // A CCC written in this connection is final, also when it turned
+    // notifications off; only a bonded host may be relying on older writes
+    if ((host.ccc_written & bit) || !host.bonded) return false;
+    return now - host.secured_ms >= CCC_GRACE_MS;
+}
+
+// Reports queued while a host was still encrypting or discovering services
+// go out back to back once it becomes ready, instead of one per interval.
+void EspidfBleKeyboard::check_ready_hosts_(uint32_t now) {
+    uint8_t ready = 0;
+    for (uint8_t i = 0; i < MAX_HOSTS; i++) {
+        if (hosts_[i].connected && host_accepts_(hosts_[i], ReportTarget::KEYBOARD, now)) ready |= 1 << i;
+    }
+    uint8_t became_ready = ready & ~ready_hosts_;
+    ready_hosts_ = ready;
+    if (became_ready == 0 || queue_count_ == 0) return;
+    burst_remaining_ = queue_count_;
+    ESP_LOGD(TAG, "Host ready (mask 0x%02X), flushing %u queued reports", became_ready, (unsigned) queue_count_);
+}
+
+// ── Hosts ────────────────────────────────────────────────────────────────────
+// The slot table is written by the Bluedroid task on connect/disconnect and
+// read from loop(); routing state (selection, broadcast) belongs to loop().
+bool EspidfBleKeyboard::on_connect(uint16_t conn_id, const uint8_t *bda, uint16_t interval) {
+    // Prefer the slot this host had before, then an unused one, then any free one
+    int slot = -1;
+    for (int i = 0; i < MAX_HOSTS && slot < 0; i++) {
+        if (!hosts_[i].connected && hosts_[i].known && memcmp(hosts_[i].bda, bda, sizeof(esp_bd_addr_t)) == 0) slot = i;
+    }
+    for (int i = 0; i < MAX_HOSTS && slot < 0; i++) {
+        if (!hosts_[i].connected && !hosts_[i].known) slot = i;
+    }
+    for (int i = 0; i < MAX_HOSTS && slot < 0; i++) {
+        if (!hosts_[i].connected) slot = i;
+    }
+    if (slot < 0) return false;
+    HostLink &host = hosts_[slot];
+    // A host has to subscribe again unless it is bonded; update_bonds_()
+    // restores a bonded host's subscriptions once the link is encrypted
+    host.subscribed = 0;
+    host.ccc_written = 0;
+    memcpy(host.bda, bda, sizeof(esp_bd_addr_t));
+    // Replaced by the identity address once pairing or encryption completes
+    memcpy(host.identity, bda, sizeof(esp_bd_addr_t));
+    host.identity_pending = false;
+    host.bond_checked = false;
+    host.bonded = false;
+    host.known = true;
+    host.conn_id = conn_id;
+    host.conn_interval = interval;
+    host.mtu = 23;
+    host.leds = 0;
+    // Report protocol is the default on connect
+    host.boot_protocol = false;
+    host.keyboard_handle = s_hid_report_handle;
+    // Without a passkey no encryption is requested, so don't wait for it
+    host.secured_ms = millis();
+    host.secured = !has_passkey_;
+    host.encrypted = false;
+    host.security_pending = has_passkey_;
+    host.auth_mode = 0;
+    host.congested = false;
+    host.in_flight = 0;
+    host.conf_seq = host.send_seq.load();
+    host.connected_ms = millis();
+    host.first_report_pending = true;
+    host.connected = true;
+    connect_count_++;
+    ESP_LOGI(TAG, "Host %d connected: %02x:%02x:%02x:%02x:%02x:%02x", slot, bda[0], bda[1], bda[2], bda[3],
+             bda[4], bda[5]);
+    return true;
+}
+
+void EspidfBleKeyboard::on_disconnect(uint16_t conn_id) {
+    int slot = find_host_(conn_id);
+    if (slot < 0) return;
+    hosts_[slot].connected = false;
+    ESP_LOGI(TAG, "Host %d disconnected", slot);
+    if (fast_reconnect_) {
+        // The bond list holds identity addresses, not a private one the host
+        // connected with
+        memcpy(last_host_bda_, hosts_[slot].identity, sizeof(esp_bd_addr_t));
+        disconnect_ms_ = millis();
+        reconnect_pending_ = true;
+    }
+}
+
+void EspidfBleKeyboard::rehome_hosts_() {
+    for (uint8_t i = 0; i < MAX_HOSTS; i++) {
+        HostLink &host = hosts_[i];
+        if (!host.connected || !host.identity_pending.exchange(false)) continue;
+        // on_connect() already matched a host connecting from its identity
+        if (memcmp(host.identity, host.bda, sizeof(esp_bd_addr_t)) == 0) continue;
+        for (uint8_t j = 0; j < MAX_HOSTS; j++) {
+            const HostLink &old = hosts_[j];
+            if (j == i || old.connected || !old.known) continue;
+            if (memcmp(old.identity, host.identity, sizeof(esp_bd_addr_t)) == 0 ||
+                memcmp(old.bda, host.identity, sizeof(esp_bd_addr_t)) == 0) {
+                move_host_(i, j);
+                break;
+            }
+        }
+    }
+}
+
+// The Bluedroid task finds a host by conn_id. While both slots are marked
+// connected it may update either; at worst an in-flight count is lost, which
+// the confirmation timeout recovers.
+void EspidfBleKeyboard::move_host_(uint8_t from, uint8_t to) {
+    HostLink &src = hosts_[from];
+    HostLink &dst = hosts_[to];
+    dst.conn_id = src.conn_id.load();
+    memcpy(dst.bda, src.bda, sizeof(esp_bd_addr_t));
+    memcpy(dst.identity, src.identity, sizeof(esp_bd_addr_t));
+    dst.known = true;
+    dst.identity_pending = false;
+    dst.bond_checked = src.bond_checked;
+    dst.bonded = src.bonded;
+    dst.conn_interval = src.conn_interval.load();
+    dst.mtu = src.mtu.load();
+    dst.subscribed = src.subscribed.load();
+    dst.ccc_written = src.ccc_written.load();
+    dst.secured_ms = src.secured_ms.load();
+    dst.secured = src.secured.load();
+    dst.encrypted = src.encrypted.load();
+    dst.security_pending = src.security_pending.load();
+    dst.auth_mode = src.auth_mode.load();
+    dst.bond_dirty = src.bond_dirty.load();
+    dst.leds = src.leds.load();
+    dst.boot_protocol = src.boot_protocol.load();
+    dst.keyboard_handle = src.keyboard_handle.load();
+    dst.congested = src.congested.load();
+    dst.in_flight = src.in_flight.load();
+    dst.in_flight_since_ms = src.in_flight_since_ms;
+    dst.connected_ms = src.connected_ms;
+    dst.first_report_pending = src.first_report_pending;
+    for (size_t i = 0; i < IN_FLIGHT_SLOTS; i++) dst.in_flight_enqueued_ms[i] = src.in_flight_enqueued_ms[i].load();
+    dst.send_seq = src.send_seq.load();
+    dst.conf_seq = src.conf_seq.load();
+    dst.connected = true;
+    src.connected = false;
+    src.known = false;
+
+    // Reports already queued for the host follow it
+    auto move_bit = [from, to](uint8_t mask) -> uint8_t {
+        return mask & (1 << from) ? (mask & ~(1 << from)) | (1 << to) : mask;
+    };
+    for (size_t i = 0; i < queue_count_; i++) {
+        QueuedReport &report = queue_[(queue_tail_ + i) % REPORT_QUEUE_SIZE];
+        report.hosts = move_bit(report.hosts);
+    }
+    report_sent_mask_ = move_bit(report_sent_mask_);
+    ready_hosts_ = move_bit(ready_hosts_);
+    fast_hosts_ = move_bit(fast_hosts_);
+    ESP_LOGI(TAG, "Host %u is host %u again (private address resolved)", from, to);
+}
+
+int EspidfBleKeyboard::find_host_(uint16_t conn_id) const {
+    for (int i = 0; i < MAX_HOSTS; i++) {
+        if (hosts_[i].connected && hosts_[i].conn_id == conn_id) return i;
+    }
+    return -1;
+}
+
+uint8_t EspidfBleKeyboard::connected_mask_() const {
+    uint8_t mask = 0;
+    for (uint8_t i = 0; i < MAX_HOSTS; i++) {
+        if (hosts_[i].connected) mask |= 1 << i;
+    }
+    return mask;
+}
+
+uint8_t EspidfBleKeyboard::connected_hosts() const {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < MAX_HOSTS; i++) count += hosts_[i].connected;
+    return count;
+}
+
+int EspidfBleKeyboard::primary_host_() const {
+    uint8_t selected = selected_host_;
+    if (hosts_[selected].connected) return selected;
+    for (int i = 0; i < MAX_HOSTS; i++) {
+        if (hosts_[i].connected) return i;
+    }
+    return -1;
+}
+
+uint8_t EspidfBleKeyboard::route_mask_() const {
+    if (route_override_ != 0) return route_override_ & connected_mask_();
+    if (broadcast_) return connected_mask_();
+    int primary = primary_host_();
+    return primary < 0 ? 0 : 1 << primary;
+}
+
+uint8_t EspidfBleKeyboard::led_state() const {
+    // While send_string_to() types on one host, text is cased for that host
+    for (uint8_t i = 0; i < MAX_HOSTS && route_override_ != 0; i++) {
+        if (route_override_ & (1 << i)) return hosts_[i].leds;
+    }
+    int primary = primary_host_();
+    return primary < 0 ? 0 : hosts_[primary].leds.load();
+}
+
+void EspidfBleKeyboard::select_host(uint8_t slot) {
+    if (slot >= MAX_HOSTS) {
+        ESP_LOGW(TAG, "No host slot %u (0-%u)", slot, MAX_HOSTS - 1);
+        return;
+    }
+    // Finish the pending report for the previous host first
+    flush_packed_keys_();
+    selected_host_ = slot;
+    ESP_LOGI(TAG, "Typing on host %u%s", slot, hosts_[slot].connected ? "" : " (not connected)");
+}
+
+void EspidfBleKeyboard::select_next_host() {
+    uint8_t selected = selected_host_;
+    for (uint8_t i = 1; i <= MAX_HOSTS; i++) {
+        uint8_t slot = (selected + i) % MAX_HOSTS;
+        if (hosts_[slot].connected) {
+            select_host(slot);
+            return;
+        }
+    }
+}
+
+void EspidfBleKeyboard::send_string_to(uint8_t slot, const std::string &str) {
+    if (!is_host_connected(slot)) return;
+    flush_packed_keys_();
+    route_override_ = 1 << slot;
+    send_string(str);
+    route_override_ = 0;
+}
+
+void EspidfBleKeyboard::on_congestion(uint16_t conn_id, bool congested) {
+    int slot = find_host_(conn_id);
+    if (slot < 0) return;
+    hosts_[slot].congested = congested;
+    if (congested) congestion_events_++;
+}
+
+void EspidfBleKeyboard::on_notification_confirmed(uint16_t conn_id, bool success) {
+    if (!success) notifications_dropped_++;
+    int slot = find_host_(conn_id);
+    if (slot < 0) return;
+    HostLink &host = hosts_[slot];
+    uint8_t n = host.in_flight;
+    while (n > 0 && !host.in_flight.compare_exchange_weak(n, n - 1)) {}
+    // Confirmations arrive in send order
+    uint32_t seq = host.conf_seq;
+    if (seq != host.send_seq) {
+        host.conf_seq = seq + 1;
+        if (success) record_latency_(millis() - host.in_flight_enqueued_ms[seq % IN_FLIGHT_SLOTS]);
+    }
+}
+
+void EspidfBleKeyboard::on_subscription(uint16_t conn_id, uint8_t report, bool enabled) {
+    int slot = find_host_(conn_id);
+    if (slot < 0) return;
+    hosts_[slot].ccc_written |= report;
+    if (enabled) {
+        hosts_[slot].subscribed |= report;
+    } else {
+        hosts_[slot].subscribed &= ~report;
+    }
+    // Bonded hosts don't write their CCCs again; remember them
+    if (hosts_[slot].encrypted) hosts_[slot].bond_dirty = true;
+}
+
+void EspidfBleKeyboard::on_protocol_mode(uint16_t conn_id, uint8_t mode) {
+    int slot = find_host_(conn_id);
+    if (slot < 0) return;
+    HostLink &host = hosts_[slot];
+    host.boot_protocol = mode == 0;
+    // Keyboard reports follow the mode: boot hosts only read the boot input
+    host.keyboard_handle = mode == 0 ? s_boot_input_handle : s_hid_report_handle;
+    ESP_LOGD(TAG, "Host %d: %s protocol mode", slot, mode == 0 ? "boot" : "report");
+}
+
+void EspidfBleKeyboard::on_auth_complete(const uint8_t *bda, bool success, uint8_t auth_mode) {
+    if (!success) return;
+    // The event may carry the host's identity address rather than the one it
+    // connected with; then it belongs to the newest host still pairing.
+    // Without a passkey hosts count as secured from the start, but may still
+    // pair or encrypt (Just Works).
+    HostLink *match = nullptr;
+    for (auto &host : hosts_) {
+        if (!host.connected || host.encrypted) continue;
+        if (memcmp(host.bda, bda, sizeof(esp_bd_addr_t)) == 0) {
+            match = &host;
+            break;
+        }
+        if (!match || host.connected_ms - match->connected_ms < UINT32_MAX / 2) match = &host;
+    }
+    if (!match) return;
+    memcpy(match->identity, bda, sizeof(esp_bd_addr_t));
+    match->identity_pending = true;
+    match->auth_mode = auth_mode;
+    match->secured_ms = millis();
+    match->secured = true;
+    match->encrypted = true;
+    match->bond_dirty = true;
+}
+
+void EspidfBleKeyboard::set_conn_interval(const uint8_t *bda, uint16_t interval) {
+    for (auto &host : hosts_) {
+        if (host.connected && memcmp(host.bda, bda, sizeof(esp_bd_addr_t)) == 0) host.conn_interval = interval;
+    }
+}
+
+void EspidfBleKeyboard::set_mtu(uint16_t conn_id, uint16_t mtu) {
+    int slot = find_host_(conn_id);
+    if (slot >= 0) hosts_[slot].mtu = mtu;
+}
+
+void EspidfBleKeyboard::set_led_state(uint16_t conn_id, uint8_t leds) {
+    int slot = find_host_(conn_id);
+    if (slot >= 0) hosts_[slot].leds = leds;
+}
+
+bool EspidfBleKeyboard::enqueue_report_(ReportTarget target, const uint8_t *data, uint8_t len, uint16_t delay_ms) {
+    if (queue_count_ >= REPORT_QUEUE_SIZE || len > sizeof(QueuedReport::data)) return false;
+    if (!report_enabled(target)) return false;
+    QueuedReport &report = queue_[queue_head_];
+    report.target = target;
+    report.len = len;
+    report.hosts = route_mask_();
+    report.paste = pasting_;
+    report.delay_ms = delay_ms;
+    report.enqueued_ms = millis();
+    memset(report.data, 0, sizeof(report.data));
+    if (len > 0) memcpy(report.data, data, len);
+    queue_head_ = (queue_head_ + 1) % REPORT_QUEUE_SIZE;
+    if (queue_count_++ == 0) high_freq_.start();
+    if (queue_count_ > queue_high_water_) queue_high_water_ = queue_count_;
+    return true;
+}
+
+bool EspidfBleKeyboard::enqueue_press_release_(ReportTarget target, const uint8_t *data, uint8_t len) {
+    if (!report_enabled(target)) {
+        ESP_LOGW(TAG, "%s reports are not enabled in 'reports', ignoring",
+                 target == ReportTarget::CONSUMER ? "Consumer" : target == ReportTarget::SYSTEM ? "System" : "Mouse");
+        return false;
+    }
+    // Never queue a press without room for its release — that would leave a stuck key
+    if (queue_free_() < 2) {
+        ESP_LOGW(TAG, "Report queue full, dropping key press");
+        return false;
+    }
+    static const uint8_t release[sizeof(QueuedReport::data)] = {0};
+    enqueue_report_(target, data, len, 0);
+    enqueue_report_(target, release, len, 0);
+    return true;
+}
+
+// Boot protocol hosts only parse the 6-key boot report: send the first six
+// held keys of an NKRO bitmap that way. Report ID 1 already has that layout.
+static void nkro_to_boot(const uint8_t *nkro, uint8_t *boot) {
+    memset(boot, 0, 8);
+    boot[0] = nkro[0];
+    uint8_t n = 0;
+    for (uint8_t key = 0; key <= NKRO_MAX_KEY && n < 6; key++) {
+        if (nkro[1 + key / 8] & (1 << (key % 8))) boot[2 + n++] = key;
+    }
+}
+
+bool EspidfBleKeyboard::send_report_(const QueuedReport &report, HostLink &host) {
+    uint16_t handle;
+    const uint8_t *data = report.data;
+    uint8_t len = report.len;
+#if ESPIDF_BLE_KEYBOARD_NKRO
+    uint8_t boot[8];
+#endif
+    // enqueue_report_ only accepts enabled report types
+    switch (report.target) {
+        case ReportTarget::KEYBOARD: handle = host.keyboard_handle; break;
+#if ESPIDF_BLE_KEYBOARD_CONSUMER
+        case ReportTarget::CONSUMER:
+            // No boot protocol equivalent; the host would ignore it
+            if (host.boot_protocol) return true;
+            handle = s_consumer_report_handle;
+            break;
+#endif
+#if ESPIDF_BLE_KEYBOARD_SYSTEM
+        case ReportTarget::SYSTEM:
+            if (host.boot_protocol) return true;
+            handle = s_system_report_handle;
+            break;
+#endif
+#if ESPIDF_BLE_KEYBOARD_MOUSE
+        case ReportTarget::MOUSE:
+            // Boot mice are a separate device; boot keyboards can't move a pointer
+            if (host.boot_protocol) return true;
+            handle = s_mouse_report_handle;
+            break;
+#endif
+#if ESPIDF_BLE_KEYBOARD_NKRO
+        case ReportTarget::NKRO:
+            if (!host.boot_protocol) {
+                handle = s_nkro_report_handle;
+                break;
+            }
+            nkro_to_boot(report.data, boot);
+            handle = host.keyboard_handle;
+            data = boot;
+            len = sizeof(boot);
+            break;
+#endif
+        default: return true;  // Delay step
+    }
+    esp_err_t err = esp_ble_gatts_send_indicate(s_gatts_if, host.conn_id, handle, len,
+                                                const_cast<uint8_t *>(data), false);
+    if (err != ESP_OK) return false;
+    notifications_sent_++;
+    uint32_t seq = host.send_seq;
+    host.in_flight_enqueued_ms[seq % IN_FLIGHT_SLOTS] = report.enqueued_ms;
+    host.send_seq = seq + 1;
+    host.in_flight++;
+    host.in_flight_since_ms = millis();
+    return true;
+}
+
+void EspidfBleKeyboard::clear_queue_() {
+    queue_head_ = queue_tail_ = queue_count_ = 0;
+    next_gap_ms_ = 0;
+    send_attempts_ = 0;
+    report_sent_mask_ = 0;
+    burst_remaining_ = 0;
+    high_freq_.stop();
+}
+
+// ── Key State (NKRO) ─────────────────────────────────────────────────────────
+// Bit of a key in key_state_: modifiers in byte 0, then one bit per usage.
+// Null for keys the report can't hold.
+static uint8_t *key_state_bit(uint8_t *state, uint8_t keycode, uint8_t &bit) {
+    if (keycode >= 0xE0 && keycode <= 0xE7) {
+        bit = 1 << (keycode - 0xE0);
+        return &state[0];
+    }
+    if (keycode > NKRO_MAX_KEY) return nullptr;
+    bit = 1 << (keycode % 8);
+    return &state[1 + keycode / 8];
+}
+
+bool EspidfBleKeyboard::set_key_(uint8_t keycode, bool down) {
+    uint8_t bit;
+    uint8_t *byte = key_state_bit(key_state_, keycode, bit);
+    if (byte == nullptr) {
+        ESP_LOGW(TAG, "Key 0x%02X is outside the NKRO report", keycode);
+        return false;
+    }
+    if (((*byte & bit) != 0) == down) return true;  // No change, nothing to send
+    if (!is_connected()) return false;
+    if (!down) {
+        // Goes out from loop() if the queue is full, see send_key_state_()
+        *byte &= ~bit;
+        send_key_state_();
+        return true;
+    }
+    bool was_dirty = key_state_dirty_;
+    *byte |= bit;
+    if (send_key_state_()) return true;
+    // Refused presses must not go out later with the retried state
+    *byte &= ~bit;
+    key_state_dirty_ = was_dirty;
+    return false;
+}
+
+// A state that doesn't fit the queue stays dirty and loop() sends it once
+// there is room, so a release is never lost to a full queue.
+bool EspidfBleKeyboard::send_key_state_() {
+#if ESPIDF_BLE_KEYBOARD_NKRO
+    bool queued = enqueue_report_(ReportTarget::NKRO, key_state_, NKRO_REPORT_LEN, 0);
+#else
+    // Without the NKRO report, the first six held keys go out on Report ID 1
+    uint8_t boot[8];
+    nkro_to_boot(key_state_, boot);
+    bool queued = enqueue_report_(ReportTarget::KEYBOARD, boot, sizeof(boot), 0);
+#endif
+    if (!queued && !key_state_dirty_) ESP_LOGW(TAG, "Report queue full, key state will be sent later");
+    key_state_dirty_ = !queued;
+    return queued;
+}
+
+void EspidfBleKeyboard::release_all() {
+    static const uint8_t none[NKRO_REPORT_LEN] = {0};
+    if (memcmp(key_state_, none, NKRO_REPORT_LEN) == 0) return;
+    memset(key_state_, 0, sizeof(key_state_));
+    if (is_connected()) send_key_state_();
+}
+
+bool EspidfBleKeyboard::is_pressed(uint8_t keycode) const {
+    uint8_t bit;
+    const uint8_t *byte = key_state_bit(const_cast<uint8_t *>(key_state_), keycode, bit);
+    return byte != nullptr && (*byte & bit);
+}
+
+// ── Timed Keys ───────────────────────────────────────────────────────────────
+// hold() and repeat() only queue reports and schedule their next step with
+// set_timeout(), so any number of them run side by side without blocking.
+// timed_epoch_ changes when the last host disconnects, which cancels them.
+static uint8_t hold_slot(uint8_t keycode) {
+    return keycode >= 0xE0 ? NKRO_MAX_KEY + 1 + (keycode - 0xE0) : keycode;
+}
+
+bool EspidfBleKeyboard::hold(uint8_t modifiers, uint8_t keycode, uint32_t duration_ms) {
+    if (!is_connected()) return false;
+    if (keycode > NKRO_MAX_KEY && !(keycode >= 0xE0 && keycode <= 0xE7)) {
+        ESP_LOGW(TAG, "Key 0x%02X is outside the NKRO report", keycode);
+        return false;
+    }
+    // Set every key first so the whole combination goes out in one report
+    uint8_t before[NKRO_REPORT_LEN];
+    memcpy(before, key_state_, sizeof(before));
+    bool was_dirty = key_state_dirty_;
+    for (uint8_t i = 0; i <= 8; i++) {
+        uint8_t key = i < 8 ? 0xE0 + i : keycode;
+        if (i < 8 ? !(modifiers & (1 << i)) : key == 0) continue;
+        hold_refs_[hold_slot(key)]++;
+        uint8_t bit;
+        uint8_t *byte = key_state_bit(key_state_, key, bit);
+        *byte |= bit;
+    }
+    if (memcmp(before, key_state_, sizeof(before)) != 0 && !send_key_state_()) {
+        // Nothing will release these keys: undo, or they would go out with
+        // the next key state report and stay stuck on the host
+        memcpy(key_state_, before, sizeof(before));
+        key_state_dirty_ = was_dirty;
+        for (uint8_t i = 0; i <= 8; i++) {
+            uint8_t key = i < 8 ? 0xE0 + i : keycode;
+            if (i < 8 ? !(modifiers & (1 << i)) : key == 0) continue;
+            hold_refs_[hold_slot(key)]--;
+        }
+        return false;
+    }
+    uint32_t epoch = timed_epoch_;
+    set_timeout(duration_ms, [this, modifiers, keycode, epoch]() { end_hold_(modifiers, keycode, epoch); });
+    return true;
+}
+
+void EspidfBleKeyboard::end_hold_(uint8_t modifiers, uint8_t keycode, uint32_t epoch) {
+    if (epoch != timed_epoch_) return;
+    // A key held by several overlapping holds is released with the last one
+    bool changed = false;
+    for (uint8_t i = 0; i <= 8; i++) {
+        uint8_t key = i < 8 ? 0xE0 + i : keycode;
+        if (i < 8 ? !(modifiers & (1 << i)) : key == 0) continue;
+        uint8_t &refs = hold_refs_[hold_slot(key)];
+        if (refs == 0 || --refs > 0) continue;
+        uint8_t bit;
+        uint8_t *byte = key_state_bit(key_state_, key, bit);
+        changed |= (*byte & bit) != 0;
+        *byte &= ~bit;
+    }
+    // A full queue leaves the release to loop(), see send_key_state_()
+    if (changed && is_connected()) send_key_state_();
+}
+
+bool EspidfBleKeyboard::repeat(uint8_t keycode, uint16_t count, float rate_hz, uint8_t modifiers) {
+    if (!is_connected() || count == 0 || rate_hz <= 0.0f) return false;
+    uint32_t period_ms = std::max<uint32_t>(1, lroundf(1000.0f / rate_hz));
+    repeat_step_(modifiers, keycode, count, period_ms, millis(), timed_epoch_);
+    return true;
+}
+
+void EspidfBleKeyboard::repeat_step_(uint8_t modifiers, uint8_t keycode, uint16_t remaining, uint32_t period_ms,
+                                     uint32_t due_ms, uint32_t epoch) {
+    if (epoch != timed_epoch_) return;
+    send_key_combo(modifiers, keycode);
+    if (--remaining == 0) return;
+    // Schedule against the planned time so loop jitter doesn't add up
+    due_ms += period_ms;
+    int32_t wait = (int32_t) (due_ms - millis());
+    set_timeout(wait > 0 ? wait : 0, [this, modifiers, keycode, remaining, period_ms, due_ms, epoch]() {
+        repeat_step_(modifiers, keycode, remaining, period_ms, due_ms, epoch);
+    });
+}
+
+void EspidfBleKeyboard::send_string(const char *str, size_t len) {
+    uint8_t hosts = route_mask_();
+    if (hosts == 0 || len == 0) return;
+    // Whatever doesn't fit the queue now is typed from loop(), after any
+    // text that is still waiting
+    if (!pending_text_.empty() && pending_text_.back().hosts == hosts) {
+        pending_text_.back().text.append(str, len);
+    } else {
+        pending_text_.push_back({std::string(str, len), 0, hosts, 0});
+    }
+    advance_text_();
+}
+
+void EspidfBleKeyboard::advance_text_() {
+    // Room for flushing packed keys plus a dead-key character, so the packed
+    // keys can always be flushed when the queue runs out of room
+    static const size_t CHAR_SLOTS = 8;
+    uint8_t route = route_override_;
+    while (!pending_text_.empty()) {
+        PendingText &text = pending_text_.front();
+        uint8_t hosts = text.hosts & connected_mask_();
+        if (hosts != 0) {
+            route_override_ = hosts == route_mask_() ? route : hosts;
+            const char *start = text.text.data();
+            const char *p = start + text.pos;
+            const char *end = start + text.text.size();
+            while (p < end && queue_free_() >= CHAR_SLOTS) {
+                CharMapping mapping = map_char_(utf8_next(p, end));
+                if (mapping.key.keycode == 0) {
+                    text.unmapped++;
+                    continue;
+                }
+                pack_char_(mapping);
+            }
+            flush_packed_keys_();
+            route_override_ = route;
+            text.pos = p - start;
+            if (p < end) break;
+        }
+        if (text.unmapped > 0)
+            ESP_LOGW(TAG, "Skipped %u characters with no key mapping", (unsigned) text.unmapped);
+        pending_text_.pop_front();
+    }
+}
+
+// ── Telemetry ────────────────────────────────────────────────────────────────
+// Counters are atomics bumped on the send path and in Bluedroid callbacks;
+// sensors are published from loop() at most once per telemetry interval.
+static const uint16_t LATENCY_BUCKET_MS[LATENCY_BUCKET_COUNT] = {5, 10, 15, 20, 30, 45, 60, 90, 125, 250, 500, 1000};
+
+void EspidfBleKeyboard::record_latency_(uint32_t latency_ms) {
+    size_t bucket = 0;
+    while (bucket < LATENCY_BUCKET_COUNT - 1 && latency_ms > LATENCY_BUCKET_MS[bucket]) bucket++;
+    latency_hist_[bucket]++;
+}
+
+bool EspidfBleKeyboard::take_latency_percentiles_(uint32_t &p50, uint32_t &p95) {
+    uint32_t counts[LATENCY_BUCKET_COUNT];
+    uint32_t total = 0;
+    for (size_t i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+        counts[i] = latency_hist_[i].exchange(0);
+        total += counts[i];
+    }
+    if (total == 0) return false;
+    uint32_t seen = 0;
+    p50 = p95 = 0;
+    for (size_t i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+        seen += counts[i];
+        if (p50 == 0 && seen * 2 >= total) p50 = LATENCY_BUCKET_MS[i];
+        if (p95 == 0 && seen * 20 >= total * 19) p95 = LATENCY_BUCKET_MS[i];
+    }
+    return true;
+}
+
+#ifdef USE_SENSOR
+void EspidfBleKeyboard::publish_telemetry_() {
+    if (rssi_updated_.exchange(false) && rssi_sensor_) rssi_sensor_->publish_state(rssi_);
+    uint32_t now = millis();
+    if (now - last_telemetry_ms_ < telemetry_interval_ms_) return;
+    last_telemetry_ms_ = now;
+
+    if (notifications_sent_sensor_) notifications_sent_sensor_->publish_state(notifications_sent_);
+    if (notifications_failed_sensor_) notifications_failed_sensor_->publish_state(notifications_retried_);
+    if (notifications_dropped_sensor_) notifications_dropped_sensor_->publish_state(notifications_dropped_);
+    if (congestion_events_sensor_) congestion_events_sensor_->publish_state(congestion_events_);
+    if (queue_high_water_sensor_) queue_high_water_sensor_->publish_state(queue_high_water_);
+    uint32_t p50, p95;
+    if ((latency_p50_sensor_ || latency_p95_sensor_) && take_latency_percentiles_(p50, p95)) {
+        if (latency_p50_sensor_) latency_p50_sensor_->publish_state(p50);
+        if (latency_p95_sensor_) latency_p95_sensor_->publish_state(p95);
+    }
+    // Link sensors follow the host reports currently go to
+    int primary = primary_host_();
+    if (primary < 0) return;
+    HostLink &host = hosts_[primary];
+    if (conn_interval_sensor_ && host.conn_interval != 0) conn_interval_sensor_->publish_state(host.conn_interval * 1.25f);
+    if (mtu_sensor_) mtu_sensor_->publish_state(host.mtu);
+    // Published once the controller answers (READ_RSSI_COMPLETE_EVT)
+    if (rssi_sensor_) esp_ble_gap_read_rssi(host.bda);
+}
+#endif
+
+// ── Report Packing ───────────────────────────────────────────────────────────
+// The packer decides which keystrokes share a report (see report_packer.h);
+// each flushed report is queued as one press followed by one release.
+size_t EspidfBleKeyboard::pack_key_(uint8_t modifier, uint8_t keycode) {
+    size_t dropped = 0;
+    if (active_packer_().needs_flush(modifier, keycode)) dropped = flush_packed_keys_();
+    active_packer_().add(modifier, keycode);
+    return dropped;
+}
+
+size_t EspidfBleKeyboard::pack_char_(const CharMapping &mapping) {
+    if (mapping.dead.keycode == 0) return pack_key_(mapping.key.modifier, mapping.key.keycode);
+    // Dead-key sequences are sent unpacked so the OS composes exactly this pair
+    size_t dropped = flush_packed_keys_();
+    pack_key_(mapping.dead.modifier, mapping.dead.keycode);
+    dropped += flush_packed_keys_();
+    pack_key_(mapping.key.modifier, mapping.key.keycode);
+    dropped += flush_packed_keys_();
+    return dropped;
+}
+
+size_t EspidfBleKeyboard::flush_packed_keys_() {
+    KeyReportPacker &packer = active_packer_();
+    size_t dropped = 0;
+    if (!packer.empty() && queue_free_() >= 2) {
+        enqueue_press_release_(ReportTarget::KEYBOARD, packer.report(), 8);
+    } else {
+        dropped = packer.size();
+    }
+    packer.clear();
+    return dropped;
+}
+
+// ── Lock State ───────────────────────────────────────────────────────────────
+// Host LED writes land in led_state_ from the Bluedroid task; sensors are
+// only published from loop().
+void EspidfBleKeyboard::publish_leds_() {
+    uint8_t leds = led_state() & (LED_NUM_LOCK | LED_CAPS_LOCK | LED_SCROLL_LOCK);
+    if (leds == published_leds_) return;
+    published_leds_ = leds;
+    ESP_LOGD(TAG, "Host LEDs: num=%s caps=%s scroll=%s", ONOFF(leds & LED_NUM_LOCK),
+             ONOFF(leds & LED_CAPS_LOCK), ONOFF(leds & LED_SCROLL_LOCK));
+#ifdef USE_BINARY_SENSOR
+    if (num_lock_binary_sensor_) num_lock_binary_sensor_->publish_state(leds & LED_NUM_LOCK);
+    if (caps_lock_binary_sensor_) caps_lock_binary_sensor_->publish_state(leds & LED_CAPS_LOCK);
+    if (scroll_lock_binary_sensor_) scroll_lock_binary_sensor_->publish_state(leds & LED_SCROLL_LOCK);
+#endif
 }
 
 void EspidfBleKeyboard::send_key_combo(uint8_t modifiers, uint8_t keycode) {
-    if (!is_connected_) return;
+    if (!is_connected()) return;
     uint8_t report[8] = {0};
     report[0] = modifiers;
     report[2] = keycode;
-    // Send press
-    esp_ble_gatts_send_indicate(s_gatts_if, conn_id_, s_hid_report_handle, 8, report, false);
-    vTaskDelay(pdMS_TO_TICKS(30));
-    // Send release (all zeros)
-    memset(report, 0, 8);
-    esp_ble_gatts_send_indicate(s_gatts_if, conn_id_, s_hid_report_handle, 8, report, false);
+    enqueue_press_release_(ReportTarget::KEYBOARD, report, 8);
 }
 
 void EspidfBleKeyboard::send_ctrl_alt_del() {
-    if (!is_connected_) return;
-    uint8_t report[8] = {0};
-    report[0] = 0x05; report[2] = 0x4C;
-    esp_ble_gatts_send_indicate(s_gatts_if, conn_id_, s_hid_report_handle, 8, report, false);
-    vTaskDelay(pdMS_TO_TICKS(50));
-    memset(report, 0, 8);
-    esp_ble_gatts_send_indicate(s_gatts_if, conn_id_, s_hid_report_handle, 8, report, false);
+    play_macro(MACRO_CTRL_ALT_DEL, sizeof(MACRO_CTRL_ALT_DEL));
 }
 
 
 void EspidfBleKeyboard::send_sleep() {
-    if (!is_connected_) return;
-    // Use HID System Sleep — clean OS-level sleep, no lingering key state
-    uint8_t report[1] = {0x82};  // 0x82 = System Sleep
-    esp_ble_gatts_send_indicate(s_gatts_if, conn_id_, s_system_report_handle, 1, report, false);
-    vTaskDelay(pdMS_TO_TICKS(50));
-    uint8_t release[1] = {0};
-    esp_ble_gatts_send_indicate(s_gatts_if, conn_id_, s_system_report_handle, 1, release, false);
-    ESP_LOGI("espidf_ble_keyboard", "System Sleep sent");
+    if (play_macro(MACRO_SYSTEM_SLEEP, sizeof(MACRO_SYSTEM_SLEEP)))
+        ESP_LOGI("espidf_ble_keyboard", "System Sleep queued");
 }
 
 void EspidfBleKeyboard::send_shutdown() {
-    if (!is_connected_) return;
+    if (!is_connected()) return;
     // Use HID System Power Down — clean OS-level shutdown, no lingering key state
     send_power();
 }
 
 void EspidfBleKeyboard::send_consumer(uint16_t usage) {
-    if (!is_connected_) return;
+    if (!is_connected()) return;
     // Bluedroid handles Report ID internally — send data only (2 bytes)
     uint8_t report[2] = {(uint8_t)(usage & 0xFF), (uint8_t)(usage >> 8)};
-    esp_ble_gatts_send_indicate(s_gatts_if, conn_id_, s_consumer_report_handle, 2, report, false);
-    vTaskDelay(pdMS_TO_TICKS(50));
-    // Send release
-    uint8_t release[2] = {0, 0};
-    esp_ble_gatts_send_indicate(s_gatts_if, conn_id_, s_consumer_report_handle, 2, release, false);
-    ESP_LOGI("espidf_ble_keyboard", "Consumer report sent: 0x%04X", usage);
+    if (enqueue_press_release_(ReportTarget::CONSUMER, report, 2))
+        ESP_LOGI("espidf_ble_keyboard", "Consumer report queued: 0x%04X", usage);
 }
 
 void EspidfBleKeyboard::send_power() {
-    if (!is_connected_) return;
     // System Power Down via Generic Desktop page (Report ID 3)
-    uint8_t report[1] = {0x81};  // 0x81 = System Power Down
-    esp_ble_gatts_send_indicate(s_gatts_if, conn_id_, s_system_report_handle, 1, report, false);
-    vTaskDelay(pdMS_TO_TICKS(50));
-    uint8_t release[1] = {0};
-    esp_ble_gatts_send_indicate(s_gatts_if, conn_id_, s_system_report_handle, 1, release, false);
-    ESP_LOGI("espidf_ble_keyboard", "System Power Down sent");
+    if (play_macro(MACRO_SYSTEM_POWER_DOWN, sizeof(MACRO_SYSTEM_POWER_DOWN)))
+        ESP_LOGI("espidf_ble_keyboard", "System Power Down queued");
 }
 
 void EspidfBleKeyboard::send_media_play_pause() {
@@ -400,55 +1966,251 @@ void EspidfBleKeyboard::send_mute() {
     send_consumer(0x00E2);  // HID Consumer: Mute
 }
 
+void EspidfBleKeyboard::mouse_move(int8_t dx, int8_t dy, int8_t wheel) {
+    if (!is_connected()) return;
+    if (!report_enabled(ReportTarget::MOUSE)) {
+        ESP_LOGW(TAG, "The mouse report is not enabled in 'reports'");
+        return;
+    }
+    uint8_t report[MOUSE_REPORT_LEN] = {0, (uint8_t) dx, (uint8_t) dy, (uint8_t) wheel};
+    if (!enqueue_report_(ReportTarget::MOUSE, report, sizeof(report), 0))
+        ESP_LOGW(TAG, "Report queue full, mouse movement dropped");
+}
+
+void EspidfBleKeyboard::mouse_click(uint8_t buttons) {
+    if (!is_connected()) return;
+    uint8_t report[MOUSE_REPORT_LEN] = {buttons, 0, 0, 0};
+    enqueue_press_release_(ReportTarget::MOUSE, report, sizeof(report));
+}
+
 
 void EspidfBleKeyboard::send_hibernate() {
-    if (!is_connected_) return;
-    // Win + R to open Run dialog
-    send_key_combo(0x08, 0x15);
-    vTaskDelay(pdMS_TO_TICKS(600));
-    // Type the hibernate command
-    send_string("shutdown /h");
-    vTaskDelay(pdMS_TO_TICKS(200));
-    // Press Enter then immediately send all-zeros report to clear key state
-    send_key_combo(0x00, 0x28);
+    play_macro(MACRO_HIBERNATE, sizeof(MACRO_HIBERNATE));
 }
 
-void EspidfBleKeyboardButton::press_action() {
-    if (!parent_) return;
+// ── Macro Player ─────────────────────────────────────────────────────────────
+bool EspidfBleKeyboard::play_macro(const uint8_t *steps, size_t len) {
+    if (!is_connected()) return false;
+    if (macro_count_ > MACRO_QUEUE_SIZE) {
+        ESP_LOGW(TAG, "Macro queue full, dropping macro");
+        return false;
+    }
+    macro_queue_[macro_count_++] = {steps, len};
+    return true;
+}
 
-    // Check if the action string starts with "combo:"
-    if (action_.find("combo:") == 0) {
-        int mod, key;
-        // %i automatically reads hex values (like 0x08) into integers
-        if (sscanf(action_.c_str(), "combo:%i:%i", &mod, &key) == 2) {
-            parent_->send_key_combo((uint8_t)mod, (uint8_t)key);
-            return;
+void EspidfBleKeyboard::finish_macro_() {
+    for (uint8_t i = 1; i < macro_count_; i++) macro_queue_[i - 1] = macro_queue_[i];
+    macro_count_--;
+    macro_pc_ = 0;
+    macro_text_pos_ = 0;
+}
+
+// Turns macro steps into queued reports for as long as the report queue has
+// room; timing comes from the queue, so this never waits.
+void EspidfBleKeyboard::advance_macro_() {
+    // Worst case for one step: flushing packed keys (2) plus a press/release
+    // or a dead-key character (6)
+    static const size_t STEP_SLOTS = 8;
+    while (macro_count_ > 0 && queue_free_() >= STEP_SLOTS) {
+        const PendingMacro &macro = macro_queue_[0];
+        if (macro_pc_ >= macro.len) {
+            flush_packed_keys_();
+            finish_macro_();
+            continue;
+        }
+        const uint8_t *step = macro.steps + macro_pc_;
+        size_t left = macro.len - macro_pc_;
+        uint8_t op = step[0];
+
+        if (op == MACRO_OP_TYPE && left >= 2 && left - 2 >= step[1]) {
+            const char *text = (const char *) step + 2;
+            const char *end = text + step[1];
+            const char *p = text + macro_text_pos_;
+            while (p < end && queue_free_() >= STEP_SLOTS) {
+                CharMapping mapping = map_char_(utf8_next(p, end));
+                if (mapping.key.keycode != 0) pack_char_(mapping);
+            }
+            macro_text_pos_ = p - text;
+            if (p == end) {
+                macro_pc_ += 2 + step[1];
+                macro_text_pos_ = 0;
+            }
+            continue;
         }
+
+        flush_packed_keys_();
+        uint8_t report[8] = {0};
+        size_t step_len;
+        if ((op == MACRO_OP_TAP || op == MACRO_OP_PRESS) && left >= 3) {
+            report[0] = step[1];
+            report[2] = step[2];
+            if (op == MACRO_OP_TAP) {
+                enqueue_press_release_(ReportTarget::KEYBOARD, report, 8);
+            } else {
+                enqueue_report_(ReportTarget::KEYBOARD, report, 8, 0);
+            }
+            step_len = 3;
+        } else if (op == MACRO_OP_RELEASE) {
+            enqueue_report_(ReportTarget::KEYBOARD, report, 8, 0);
+            step_len = 1;
+        } else if (op == MACRO_OP_DELAY && left >= 3) {
+            enqueue_delay_(step[1] | (step[2] << 8));
+            step_len = 3;
+        } else if (op == MACRO_OP_CONSUMER && left >= 3) {
+            report[0] = step[1];
+            report[1] = step[2];
+            enqueue_press_release_(ReportTarget::CONSUMER, report, 2);
+            step_len = 3;
+        } else if (op == MACRO_OP_SYSTEM && left >= 2) {
+            report[0] = step[1];
+            enqueue_press_release_(ReportTarget::SYSTEM, report, 1);
+            step_len = 2;
+        } else {
+            ESP_LOGE(TAG, "Malformed macro step 0x%02X at offset %u, aborting macro", op, (unsigned) macro_pc_);
+            // Don't leave anything held down
+            enqueue_report_(ReportTarget::KEYBOARD, report, 8, 0);
+            finish_macro_();
+            continue;
+        }
+        macro_pc_ += step_len;
     }
+}
 
-    // Check if the action string starts with "consumer:"
-    if (action_.find("consumer:") == 0) {
-        int usage;
-        if (sscanf(action_.c_str(), "consumer:%i", &usage) == 1) {
-            parent_->send_consumer((uint16_t)usage);
-            return;
+// ── Streaming Paste ──────────────────────────────────────────────────────────
+size_t EspidfBleKeyboard::paste_write(const char *data, size_t len) {
+    if (!is_connected()) return 0;
+    if (!paste_buf_) paste_buf_.reset(new char[paste_size_]);
+    if (!paste_active_) {
+        paste_active_ = true;
+        paste_ended_ = false;
+        paste_chars_ = 0;
+        paste_start_ms_ = millis();
+    }
+    size_t accepted = std::min(len, paste_free());
+    for (size_t i = 0; i < accepted; i++) {
+        paste_buf_[paste_head_] = data[i];
+        paste_head_ = (paste_head_ + 1) % paste_size_;
+    }
+    paste_count_ += accepted;
+    return accepted;
+}
+
+void EspidfBleKeyboard::paste_end() {
+    if (paste_active_) paste_ended_ = true;
+}
+
+void EspidfBleKeyboard::paste_cancel() {
+    if (!paste_active_) return;
+    ESP_LOGI(TAG, "Paste cancelled after %u characters", (unsigned) paste_chars_);
+    reset_paste_();
+    // Drop the paste's reports only; media keys, key state and text for
+    // other hosts queued in between still go out
+    uint8_t hosts = 0;
+    size_t kept = 0;
+    size_t write = queue_tail_;
+    for (size_t n = 0, read = queue_tail_; n < queue_count_; n++, read = (read + 1) % REPORT_QUEUE_SIZE) {
+        const QueuedReport &report = queue_[read];
+        if (report.paste) hosts |= report.hosts;
+        // The head report may already have reached some of its hosts
+        if (report.paste && !(n == 0 && report_sent_mask_ != 0)) {
+            if (n == 0) send_attempts_ = 0;
+            continue;
         }
+        if (write != read) queue_[write] = report;
+        write = (write + 1) % REPORT_QUEUE_SIZE;
+        kept++;
+    }
+    size_t removed = queue_count_ - kept;
+    burst_remaining_ = burst_remaining_ > removed ? burst_remaining_ - removed : 0;
+    queue_head_ = write;
+    queue_count_ = kept;
+    if (queue_count_ == 0) high_freq_.stop();
+    // A press may have gone out without its release: release the keys on
+    // every host the paste was typing on, but never leave a key held down
+    hosts &= connected_mask_();
+    if (hosts == 0) return;
+#if ESPIDF_BLE_KEYBOARD_NKRO
+    static const uint8_t idle[8] = {0};
+#else
+    // Held keys share Report ID 1 without the NKRO report
+    uint8_t idle[8];
+    nkro_to_boot(key_state_, idle);
+#endif
+    uint8_t route = route_override_;
+    route_override_ = hosts;
+    enqueue_report_(ReportTarget::KEYBOARD, idle, sizeof(idle), 0);
+    route_override_ = route;
+}
+
+void EspidfBleKeyboard::reset_paste_() {
+    paste_head_ = paste_tail_ = paste_count_ = 0;
+    paste_packer_.clear();
+    paste_active_ = false;
+    paste_ended_ = false;
+}
+
+void EspidfBleKeyboard::advance_paste_() {
+    // Room for flushing packed keys plus a dead-key character
+    static const size_t CHAR_SLOTS = 8;
+    pasting_ = true;
+    while (paste_count_ > 0 && queue_free_() >= CHAR_SLOTS) {
+        // Gather one UTF-8 sequence; it may wrap around the ring, or still be
+        // incomplete if the writer split it across chunks
+        uint8_t lead = paste_buf_[paste_tail_];
+        size_t need = 1;
+        if ((lead & 0xE0) == 0xC0) need = 2;
+        else if ((lead & 0xF0) == 0xE0) need = 3;
+        else if ((lead & 0xF8) == 0xF0) need = 4;
+        if (paste_count_ < need) {
+            if (!paste_ended_) break;
+            need = paste_count_;
+        }
+        char seq[4];
+        for (size_t i = 0; i < need; i++) seq[i] = paste_buf_[(paste_tail_ + i) % paste_size_];
+        const char *p = seq;
+        CharMapping mapping = map_char_(utf8_next(p, seq + need));
+        size_t used = p - seq;
+        paste_tail_ = (paste_tail_ + used) % paste_size_;
+        paste_count_ -= used;
+        if (mapping.key.keycode != 0) {
+            pack_char_(mapping);
+            paste_chars_++;
+        }
+    }
+    // Don't hold packed keys back while waiting for the next chunk
+    if (paste_count_ == 0 && queue_free_() >= 2) flush_packed_keys_();
+    pasting_ = false;
+
+    if (paste_ended_ && paste_count_ == 0 && paste_packer_.empty() && queue_count_ == 0) {
+        uint32_t elapsed = millis() - paste_start_ms_;
+        ESP_LOGI(TAG, "Paste finished: %u characters in %u ms (%.1f chars/s)", (unsigned) paste_chars_,
+                 (unsigned) elapsed, elapsed > 0 ? paste_chars_ * 1000.0f / elapsed : 0.0f);
+        reset_paste_();
+    }
+}
+
+void EspidfBleKeyboardButton::press_action() {
+    if (!parent_) return;
+
+    switch (type_) {
+        case ButtonActionType::TEXT:         parent_->send_string(text_); break;
+        case ButtonActionType::KEY_COMBO:    parent_->send_key_combo(modifiers_, keycode_); break;
+        case ButtonActionType::CONSUMER:     parent_->send_consumer(usage_); break;
+        case ButtonActionType::CTRL_ALT_DEL: parent_->send_ctrl_alt_del(); break;
+        case ButtonActionType::SLEEP:        parent_->send_sleep(); break;
+        case ButtonActionType::SHUTDOWN:     parent_->send_shutdown(); break;
+        case ButtonActionType::HIBERNATE:    parent_->send_hibernate(); break;
+        case ButtonActionType::POWER:        parent_->send_power(); break;
+        case ButtonActionType::PLAY_PAUSE:   parent_->send_media_play_pause(); break;
+        case ButtonActionType::NEXT_TRACK:   parent_->send_media_next(); break;
+        case ButtonActionType::PREV_TRACK:   parent_->send_media_prev(); break;
+        case ButtonActionType::STOP:         parent_->send_media_stop(); break;
+        case ButtonActionType::VOLUME_UP:    parent_->send_volume_up(); break;
+        case ButtonActionType::VOLUME_DOWN:  parent_->send_volume_down(); break;
+        case ButtonActionType::MUTE:         parent_->send_mute(); break;
+        case ButtonActionType::MACRO:        parent_->play_macro(macro_, macro_len_); break;
     }
-    
-    // Named actions
-    if (action_ == "ctrl_alt_del")   parent_->send_ctrl_alt_del();
-    else if (action_ == "sleep")     parent_->send_sleep();
-    else if (action_ == "shutdown")  parent_->send_shutdown();
-    else if (action_ == "hibernate") parent_->send_hibernate();
-    else if (action_ == "power")     parent_->send_power();
-    else if (action_ == "play_pause")   parent_->send_media_play_pause();
-    else if (action_ == "next_track")   parent_->send_media_next();
-    else if (action_ == "prev_track")   parent_->send_media_prev();
-    else if (action_ == "stop")         parent_->send_media_stop();
-    else if (action_ == "volume_up")    parent_->send_volume_up();
-    else if (action_ == "volume_down")  parent_->send_volume_down();
-    else if (action_ == "mute")         parent_->send_mute();
-    else parent_->send_string(action_);
 }
 
 }  // namespace espidf_ble_keyboard
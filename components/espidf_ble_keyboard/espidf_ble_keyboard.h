@@ -1,22 +1,205 @@
 #pragma once
 #include "esphome/core/component.h"
+#include "esphome/core/helpers.h"
 #include "esphome/components/button/button.h"
+#ifdef USE_BINARY_SENSOR
+#include "esphome/components/binary_sensor/binary_sensor.h"
+#endif
+#ifdef USE_SENSOR
+#include "esphome/components/sensor/sensor.h"
+#endif
+#include "hid_keymap.h"
+#include "macro.h"
+#include "report_packer.h"
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <memory>
 #include <string>
 
 #include "esp_bt.h"
 #include "esp_bt_main.h"
 #include "esp_gap_ble_api.h"
 #include "esp_gatts_api.h"
+#include "nvs.h"
 #include "nvs_flash.h"
 
+// Optional report types, set from `reports:` in YAML. The keyboard report
+// (Report ID 1) and the boot keyboard characteristics are always present.
+#ifndef ESPIDF_BLE_KEYBOARD_CONSUMER
+#define ESPIDF_BLE_KEYBOARD_CONSUMER 1
+#endif
+#ifndef ESPIDF_BLE_KEYBOARD_SYSTEM
+#define ESPIDF_BLE_KEYBOARD_SYSTEM 1
+#endif
+#ifndef ESPIDF_BLE_KEYBOARD_NKRO
+#define ESPIDF_BLE_KEYBOARD_NKRO 1
+#endif
+#ifndef ESPIDF_BLE_KEYBOARD_MOUSE
+#define ESPIDF_BLE_KEYBOARD_MOUSE 0
+#endif
+
 namespace esphome {
 namespace espidf_ble_keyboard {
 
+// Which HID report characteristic a queued report is sent on.
+// NONE is a pure delay step (no notification is sent).
+enum class ReportTarget : uint8_t {
+  NONE,
+  KEYBOARD,
+  CONSUMER,
+  SYSTEM,
+  NKRO,
+  MOUSE,
+};
+
+constexpr bool report_enabled(ReportTarget target) {
+  switch (target) {
+    case ReportTarget::CONSUMER: return ESPIDF_BLE_KEYBOARD_CONSUMER;
+    case ReportTarget::SYSTEM:   return ESPIDF_BLE_KEYBOARD_SYSTEM;
+    case ReportTarget::NKRO:     return ESPIDF_BLE_KEYBOARD_NKRO;
+    case ReportTarget::MOUSE:    return ESPIDF_BLE_KEYBOARD_MOUSE;
+    default:                     return true;
+  }
+}
+
+// One pending notification. delay_ms is an extra wait after it is sent on top
+// of the normal link pacing (used for explicit delay steps). enqueued_ms feeds
+// the enqueue-to-confirmation latency histogram.
+struct QueuedReport {
+  ReportTarget target;
+  uint8_t len;
+  uint8_t hosts;  // bit per host slot the report goes to
+  bool paste;     // queued by the streaming paste, see paste_cancel()
+  uint16_t delay_ms;
+  uint32_t enqueued_ms;
+  uint8_t data[16];
+};
+
+// Fixed size, 3.5 KB of RAM; longer send_string text waits until it drains.
+static const size_t REPORT_QUEUE_SIZE = 128;
+// Notifications handed to Bluedroid that have not been confirmed yet.
+static const uint8_t MAX_IN_FLIGHT = 2;
+// In-flight limit while flushing the backlog of a host that just became ready.
+static const uint8_t BURST_MAX_IN_FLIGHT = 6;
+// Attempts per report before it is counted as dropped.
+static const uint8_t MAX_SEND_RETRIES = 5;
+
+// Enqueue times of unconfirmed notifications; a power of two that covers the
+// most notifications ever in flight (during a burst), or samples get the
+// enqueue time of a later report.
+static const uint8_t IN_FLIGHT_SLOTS = 8;
+static_assert(IN_FLIGHT_SLOTS >= BURST_MAX_IN_FLIGHT && IN_FLIGHT_SLOTS >= MAX_IN_FLIGHT,
+              "IN_FLIGHT_SLOTS must cover every unconfirmed notification");
+static_assert((IN_FLIGHT_SLOTS & (IN_FLIGHT_SLOTS - 1)) == 0, "IN_FLIGHT_SLOTS must be a power of two");
+// Latency histogram buckets, bounds in espidf_ble_keyboard.cpp.
+static const size_t LATENCY_BUCKET_COUNT = 12;
+// Concurrent host connections (also needs CONFIG_BT_ACL_CONNECTIONS >= this).
+// Must match MAX_HOSTS in ble_keyboard_const.py.
+static const uint8_t MAX_HOSTS = 4;
+
+// Report characteristics a host has enabled notifications for.
+static const uint8_t CCC_KEYBOARD = 0x01;
+static const uint8_t CCC_CONSUMER = 0x02;
+static const uint8_t CCC_SYSTEM = 0x04;
+static const uint8_t CCC_NKRO = 0x08;
+static const uint8_t CCC_BOOT_KEYBOARD = 0x10;
+static const uint8_t CCC_MOUSE = 0x20;
+
+// NKRO report (Report ID 4): modifier byte, then one bit per usage
+// 0x00-NKRO_MAX_KEY.
+static const uint8_t NKRO_MAX_KEY = 0x67;
+static const uint8_t NKRO_REPORT_LEN = 1 + (NKRO_MAX_KEY + 1) / 8;
+
+// Mouse report (Report ID 5): buttons, X, Y, wheel.
+static const uint8_t MOUSE_REPORT_LEN = 4;
+static const uint8_t MOUSE_LEFT = 0x01;
+static const uint8_t MOUSE_RIGHT = 0x02;
+static const uint8_t MOUSE_MIDDLE = 0x04;
+
+// A bonded host as remembered across reboots (bond cache, kept in NVS). The
+// keys themselves stay in Bluedroid's store; this is what the keyboard
+// learned about the host, keyed by its identity address as reported by
+// pairing and the bond list. Hosts using resolvable private addresses
+// connect from a different address every time.
+struct BondInfo {
+  esp_bd_addr_t bda;
+  uint8_t auth_mode;       // ESP_LE_AUTH_* bits of the last pairing/encryption
+  uint8_t subscribed;      // CCC_* bits
+  uint16_t conn_interval;  // last connection interval, 1.25 ms units
+};
+static const uint8_t MAX_BONDS = 8;
+
+// Bluetooth bring-up, advanced one step per loop() so it doesn't hold up
+// the other components.
+enum class BtStartup : uint8_t {
+  NVS,          // NVS (bond storage), release Classic BT controller memory
+  CONTROLLER,   // controller init + enable in BLE mode
+  BLUEDROID,    // host stack init + enable
+  GATT,         // security params, callbacks, GATT app registration
+  ADVERTISING,  // waiting for the stack to report advertising started
+  DONE,
+};
+
+// Advertising phases after a host disconnects (fast reconnect).
+enum class AdvPhase : uint8_t {
+  OFF,        // not managed by the reconnect sequence
+  DIRECTED,   // high duty cycle directed at the host that just left
+  WHITELIST,  // undirected, only bonded hosts may connect
+  OPEN,       // anyone may connect
+};
+
+// One host slot. A host gets its old slot back when it reconnects, so slot
+// numbers stay stable for select_host(). Fields the Bluedroid task writes
+// while connected are atomic; bda is written before connected is set.
+struct HostLink {
+  std::atomic<bool> connected{false};
+  std::atomic<uint16_t> conn_id{0};
+  esp_bd_addr_t bda{0};
+  bool known{false};  // bda holds the last host seen in this slot
+  esp_bd_addr_t identity{0};  // identity address, final once encrypted is set
+  std::atomic<bool> identity_pending{false};  // pairing reported identity; loop() checks the slot
+  bool bond_checked{false};   // loop() has looked the encrypted host up in the bond cache
+  bool bonded{false};         // it was found there, i.e. bonded before this connection
+  std::atomic<uint16_t> conn_interval{0};  // 1.25 ms units, 0 = unknown
+  std::atomic<uint16_t> mtu{23};
+  std::atomic<uint8_t> subscribed{0};   // CCC_* bits
+  std::atomic<uint8_t> ccc_written{0};  // CCC_* bits the host wrote in this connection
+  std::atomic<bool> secured{false};    // encrypted, or no passkey required
+  std::atomic<bool> encrypted{false};  // paired or encrypted with stored keys; identity is final
+  std::atomic<uint32_t> secured_ms{0};
+  std::atomic<bool> security_pending{false};  // loop() still has to decide on encryption
+  std::atomic<uint8_t> auth_mode{0};          // of the last successful authentication
+  std::atomic<bool> bond_dirty{false};        // bond cache entry needs updating
+  std::atomic<uint8_t> leds{0};
+  std::atomic<bool> boot_protocol{false};  // host selected boot protocol mode
+  std::atomic<uint16_t> keyboard_handle{0};  // report or boot input, set on mode change
+  std::atomic<bool> congested{false};
+  std::atomic<uint8_t> in_flight{0};
+  uint32_t in_flight_since_ms{0};
+  uint32_t connected_ms{0};
+  bool first_report_pending{false};  // log time to the first report sent
+  // Latency telemetry: loop() writes the enqueue time of each sent report at
+  // send_seq, the Bluedroid task consumes them in order at conf_seq.
+  std::atomic<uint32_t> in_flight_enqueued_ms[IN_FLIGHT_SLOTS]{};
+  std::atomic<uint32_t> send_seq{0};
+  std::atomic<uint32_t> conf_seq{0};
+};
+
+// Lock LED bits in the keyboard output report (LED usage page).
+static const uint8_t LED_NUM_LOCK = 0x01;
+static const uint8_t LED_CAPS_LOCK = 0x02;
+static const uint8_t LED_SCROLL_LOCK = 0x04;
+
 class EspidfBleKeyboard : public Component {
  public:
   void setup() override;
   void loop() override;
-  void send_string(const std::string &str);
+  void dump_config() override;
+  void send_string(const char *str, size_t len);
+  void send_string(const char *str) { send_string(str, strlen(str)); }
+  void send_string(const std::string &str) { send_string(str.data(), str.size()); }
   void send_ctrl_alt_del();
   void send_key_combo(uint8_t modifiers, uint8_t keycode);
   void send_sleep();
@@ -32,6 +215,48 @@ class EspidfBleKeyboard : public Component {
   void send_volume_up();
   void send_volume_down();
   void send_mute();
+  // Mouse (needs `mouse` in `reports`); movement is relative, -127..127
+  void mouse_move(int8_t dx, int8_t dy, int8_t wheel = 0);
+  void mouse_click(uint8_t buttons = MOUSE_LEFT);
+
+  // Key state (NKRO): keys stay down until released, any number at once.
+  // Only changes are sent, as one bitmap report each. Modifier usages
+  // 0xE0-0xE7 set the modifier byte. Hosts in boot protocol mode (and all
+  // hosts when the nkro report is disabled) get the first six held keys in a
+  // boot keyboard report instead. press() fails on a full report queue;
+  // a release is always delivered, once the queue has room.
+  bool press(uint8_t keycode) { return set_key_(keycode, true); }
+  bool release(uint8_t keycode) { return set_key_(keycode, false); }
+  void release_all();
+  bool is_pressed(uint8_t keycode) const;
+
+  // Timed keys, driven by the component scheduler, never blocking. hold()
+  // keeps modifiers + key down for duration_ms through the key state above
+  // (key 0: modifiers only); overlapping holds of a key end with the last.
+  // repeat() taps modifiers + key count times at rate_hz. Both stop when the
+  // last host disconnects.
+  bool hold(uint8_t modifiers, uint8_t keycode, uint32_t duration_ms);
+  bool repeat(uint8_t keycode, uint16_t count, float rate_hz, uint8_t modifiers = 0);
+
+  // Plays a macro compiled to bytecode (see macro.h). Non-blocking: steps are
+  // fed into the report queue from loop(), and macros started while another
+  // one is playing run after it. steps must outlive playback (flash data).
+  bool play_macro(const uint8_t *steps, size_t len);
+
+  // Streaming paste for large UTF-8 payloads. Text is copied into a fixed
+  // ring buffer and typed from loop(); paste_write returns how many bytes
+  // fit (the caller retries the rest later), so heap use stays constant
+  // whatever the payload size. paste_end marks the end of the stream;
+  // paste_cancel drops the rest of the paste (and only the paste).
+  size_t paste_write(const char *data, size_t len);
+  size_t paste_write(const std::string &data) { return paste_write(data.data(), data.size()); }
+  void paste_end();
+  void paste_cancel();
+  bool paste_active() const { return paste_active_; }
+  size_t paste_free() const { return paste_size_ - paste_count_; }
+  size_t paste_pending() const { return paste_count_; }
+  uint32_t paste_chars_typed() const { return paste_chars_; }
+  void set_paste_buffer_size(size_t size) { paste_size_ = size; }
 
   // Setter and check for YAML-configured passkey
   void set_passkey(uint32_t passkey) { 
@@ -40,29 +265,407 @@ class EspidfBleKeyboard : public Component {
   }
   bool has_passkey() const { return has_passkey_; }
 
-  void set_connected(bool connected, uint16_t conn_id) {
-    is_connected_ = connected;
-    conn_id_ = conn_id;
+  bool is_connected() const { return connected_mask_() != 0; }
+
+  // Multiple hosts: reports go to the selected host slot (or the first
+  // connected one if it is not connected), or to every connected host while
+  // broadcasting. Switching is instant and only affects reports queued
+  // afterwards; the host keeps its connection either way.
+  void select_host(uint8_t slot);
+  void select_next_host();
+  void set_broadcast(bool broadcast) { broadcast_ = broadcast; }
+  bool broadcast() const { return broadcast_; }
+  uint8_t selected_host() const { return selected_host_; }
+  bool is_host_connected(uint8_t slot) const { return slot < MAX_HOSTS && hosts_[slot].connected; }
+  uint8_t connected_hosts() const;
+  // Types on one host without changing the selection.
+  void send_string_to(uint8_t slot, const std::string &str);
+
+  // Number of reports still waiting to be sent from loop().
+  size_t queued_reports() const { return queue_count_; }
+  // send_string() text that didn't fit the queue yet; loop() types it.
+  bool text_pending() const { return !pending_text_.empty(); }
+
+  // Lower bound on the gap between two notifications; the actual gap is the
+  // larger of this and the negotiated connection interval.
+  void set_min_report_interval(uint16_t ms) { min_report_interval_ms_ = ms; }
+  // How many distinct keys send_string may press in a single report (1-6).
+  void set_keys_per_report(uint8_t keys) {
+    packer_.set_keys_per_report(keys);
+    paste_packer_.set_keys_per_report(keys);
+  }
+
+  // Link events, called from the Bluedroid task. on_connect returns false
+  // when every host slot is taken.
+  bool on_connect(uint16_t conn_id, const uint8_t *bda, uint16_t interval);
+  void on_disconnect(uint16_t conn_id);
+  void on_congestion(uint16_t conn_id, bool congested);
+  void on_notification_confirmed(uint16_t conn_id, bool success);
+  void on_subscription(uint16_t conn_id, uint8_t report, bool enabled);
+  void on_auth_complete(const uint8_t *bda, bool success, uint8_t auth_mode);
+  void on_advertising_started();
+  void on_protocol_mode(uint16_t conn_id, uint8_t mode);
+  void set_conn_interval(const uint8_t *bda, uint16_t interval);
+  void set_mtu(uint16_t conn_id, uint16_t mtu);
+  void set_led_state(uint16_t conn_id, uint8_t leds);
+  void set_rssi(int8_t rssi) {
+    rssi_ = rssi;
+    rssi_updated_ = true;
+  }
+
+  // Low-latency typing mode: request a short connection interval while reports
+  // are queued and fall back to a power-saving one once the queue has been
+  // idle for idle_timeout_ms. Intervals are in 1.25 ms units.
+  void set_low_latency(uint16_t fast_interval, uint16_t idle_interval, uint16_t idle_latency,
+                       uint32_t idle_timeout_ms) {
+    low_latency_ = true;
+    fast_interval_ = fast_interval;
+    idle_interval_ = idle_interval;
+    idle_latency_ = idle_latency;
+    idle_timeout_ms_ = idle_timeout_ms;
   }
-  bool is_connected() const { return is_connected_; }
-  uint16_t conn_id() const { return conn_id_; }
+
+  // Fast reconnect: after a disconnect, advertise directed at the host that
+  // left (if bonded), then to bonded hosts only for whitelist_ms, then to
+  // anyone. Without it advertising is always open.
+  void set_fast_reconnect(uint32_t whitelist_ms) {
+    fast_reconnect_ = true;
+    whitelist_ms_ = whitelist_ms;
+  }
+  bool fast_reconnect() const { return fast_reconnect_; }
+
+  // Advertising profile. Payloads are built by codegen (see __init__.py) and
+  // must stay valid; intervals are in 0.625 ms units. Advertising runs at
+  // fast_interval for fast_duration_ms after boot, a disconnect or
+  // advertise_fast(), then at slow_interval (fast_duration_ms 0: always fast).
+  void set_advertising_data(const uint8_t *adv, uint8_t adv_len, const uint8_t *scan_rsp, uint8_t scan_rsp_len);
+  void set_device_name(const std::string &name) { device_name_ = name; }
+  const std::string &device_name() const { return device_name_; }
+  void set_tx_power(esp_power_level_t level) {
+    tx_power_ = level;
+    has_tx_power_ = true;
+  }
+  void set_advertising_intervals(uint16_t fast_interval, uint16_t slow_interval, uint32_t fast_duration_ms) {
+    adv_fast_interval_ = fast_interval;
+    adv_slow_interval_ = slow_interval;
+    adv_fast_duration_ms_ = fast_duration_ms;
+  }
+  // Bond cache, most recently used host first. A known host is not sent an
+  // encryption request on reconnect: it normally encrypts with the stored
+  // keys by itself, and loop() only asks if it hasn't after a short wait.
+  // Its slot is restored at boot and its subscriptions once the link is
+  // encrypted, so reports can go out right away.
+  uint8_t bond_count() const { return bond_count_; }
+  const BondInfo &bond(uint8_t index) const { return bonds_[index]; }
+  // Removes the host (by identity address) from Bluedroid and the cache; it
+  // has to pair again.
+  bool remove_bond(const uint8_t *bda);
+  void remove_all_bonds();
+
+  // Go back to fast advertising now, e.g. to pair a new host.
+  void advertise_fast();
+  // Called from the Bluedroid task: keep advertising after a connect while
+  // slots are free, and burst after a disconnect.
+  void request_advertising(bool burst) { (burst ? adv_burst_pending_ : adv_resume_pending_) = true; }
+
+  // Lock LEDs of the host reports currently go to (the send_string_to()
+  // target while it runs), as written to its output report. Typed letters
+  // take Caps Lock into account.
+  uint8_t led_state() const;
+  bool caps_lock() const { return led_state() & LED_CAPS_LOCK; }
+#ifdef USE_BINARY_SENSOR
+  void set_num_lock_binary_sensor(binary_sensor::BinarySensor *sensor) { num_lock_binary_sensor_ = sensor; }
+  void set_caps_lock_binary_sensor(binary_sensor::BinarySensor *sensor) { caps_lock_binary_sensor_ = sensor; }
+  void set_scroll_lock_binary_sensor(binary_sensor::BinarySensor *sensor) { scroll_lock_binary_sensor_ = sensor; }
+#endif
+
+  uint32_t notifications_sent() const { return notifications_sent_; }
+  uint32_t notifications_retried() const { return notifications_retried_; }
+  uint32_t notifications_dropped() const { return notifications_dropped_; }
+  uint32_t congestion_events() const { return congestion_events_; }
+  size_t queue_high_water() const { return queue_high_water_; }
+
+#ifdef USE_SENSOR
+  // Telemetry sensors, published from loop() every interval_ms.
+  void set_telemetry_interval(uint32_t interval_ms) { telemetry_interval_ms_ = interval_ms; }
+  void set_notifications_sent_sensor(sensor::Sensor *sensor) { notifications_sent_sensor_ = sensor; }
+  void set_notifications_failed_sensor(sensor::Sensor *sensor) { notifications_failed_sensor_ = sensor; }
+  void set_notifications_dropped_sensor(sensor::Sensor *sensor) { notifications_dropped_sensor_ = sensor; }
+  void set_congestion_events_sensor(sensor::Sensor *sensor) { congestion_events_sensor_ = sensor; }
+  void set_queue_high_water_sensor(sensor::Sensor *sensor) { queue_high_water_sensor_ = sensor; }
+  void set_latency_p50_sensor(sensor::Sensor *sensor) { latency_p50_sensor_ = sensor; }
+  void set_latency_p95_sensor(sensor::Sensor *sensor) { latency_p95_sensor_ = sensor; }
+  void set_conn_interval_sensor(sensor::Sensor *sensor) { conn_interval_sensor_ = sensor; }
+  void set_mtu_sensor(sensor::Sensor *sensor) { mtu_sensor_ = sensor; }
+  void set_rssi_sensor(sensor::Sensor *sensor) { rssi_sensor_ = sensor; }
+#endif
 
  protected:
-  bool is_connected_{false};
-  uint16_t conn_id_{0};
-  
+  // Report queue — send_* only enqueue, loop() drains one report per gap.
+  size_t queue_free_() const { return REPORT_QUEUE_SIZE - queue_count_; }
+  bool enqueue_report_(ReportTarget target, const uint8_t *data, uint8_t len, uint16_t delay_ms);
+  bool enqueue_delay_(uint16_t delay_ms) { return enqueue_report_(ReportTarget::NONE, nullptr, 0, delay_ms); }
+  // Queues a press report followed by an all-zero release of the same target.
+  bool enqueue_press_release_(ReportTarget target, const uint8_t *data, uint8_t len);
+  // Returns false if Bluedroid refused the notification (retry later).
+  bool send_report_(const QueuedReport &report, HostLink &host);
+  // False while the host is congested or has too many unconfirmed notifications
+  bool host_ready_(HostLink &host, uint32_t now);
+  // False until the host has subscribed to the target's report (or, if
+  // bonded, is assumed to have, see CCC_GRACE_MS) and the link is encrypted
+  // if required
+  bool host_accepts_(const HostLink &host, ReportTarget target, uint32_t now) const;
+  void check_ready_hosts_(uint32_t now);
+  void clear_queue_();
+  bool set_key_(uint8_t keycode, bool down);
+  bool send_key_state_();
+  void end_hold_(uint8_t modifiers, uint8_t keycode, uint32_t epoch);
+  void repeat_step_(uint8_t modifiers, uint8_t keycode, uint16_t remaining, uint32_t period_ms, uint32_t due_ms,
+                    uint32_t epoch);
+  uint16_t report_gap_ms_(uint8_t hosts) const;
+  int find_host_(uint16_t conn_id) const;
+  uint8_t connected_mask_() const;
+  // Hosts new reports go to, and the one whose state (LEDs, link) is shown
+  uint8_t route_mask_() const;
+  int primary_host_() const;
+  void advance_macro_();
+  void advance_text_();
+  void advance_paste_();
+  void reset_paste_();
+  void finish_macro_();
+  // Keystroke packing for typed text, into the paste's packer while
+  // advance_paste_() runs and packer_ otherwise; both return the number of
+  // keystrokes dropped because the queue was full.
+  KeyReportPacker &active_packer_() { return pasting_ ? paste_packer_ : packer_; }
+  size_t pack_key_(uint8_t modifier, uint8_t keycode);
+  size_t pack_char_(const CharMapping &mapping);
+  // lookup_char() for the host's current Caps Lock state
+  CharMapping map_char_(uint32_t codepoint) const { return lookup_char(codepoint, caps_lock()); }
+  void publish_leds_();
+  void publish_telemetry_();
+  void record_latency_(uint32_t latency_ms);
+  // Bucket bounds (ms) of the 50th/95th latency percentile since the last
+  // call, which resets the histogram. False if there were no samples.
+  bool take_latency_percentiles_(uint32_t &p50, uint32_t &p95);
+  size_t flush_packed_keys_();
+  void request_conn_params_(const HostLink &host, uint16_t interval, uint16_t latency);
+  void update_link_mode_();
+  void advance_reconnect_();
+  void start_reconnect_phase_(AdvPhase phase);
+  void advance_startup_();
+  void load_bonds_();
+  void sync_bonds_();
+  void save_bonds_();
+  int find_bond_(const uint8_t *bda) const;
+  // Whether a host connecting from bda is likely bonded and will encrypt by itself
+  bool bond_expected_(const uint8_t *bda) const;
+  bool store_bond_(const HostLink &host);
+  void erase_bond_(int index);
+  void update_bonds_();
+  // A host with a private address can't be matched to its slot on connect;
+  // once its identity is known it is moved back to the slot it had
+  void rehome_hosts_();
+  void move_host_(uint8_t from, uint8_t to);
+  void advance_advertising_();
+  void set_adv_interval_(bool fast);
+  // False if left to the reconnect sequence, which owns advertising during
+  // its directed and whitelist phases
+  bool restart_advertising_();
+  void start_gatt_();
+
+  QueuedReport queue_[REPORT_QUEUE_SIZE];
+  size_t queue_head_{0};
+  size_t queue_tail_{0};
+  size_t queue_count_{0};
+  uint32_t last_report_ms_{0};
+  uint16_t next_gap_ms_{0};
+  uint8_t send_attempts_{0};
+  uint8_t report_sent_mask_{0};  // hosts the head report has already gone to
+  uint8_t ready_hosts_{0};
+  size_t burst_remaining_{0};  // reports to send without pacing
+  HighFrequencyLoopRequester high_freq_;
+  KeyReportPacker packer_;
+  // Held keys for press()/release(), in NKRO report format
+  uint8_t key_state_[NKRO_REPORT_LEN]{0};
+  // key_state_ changed but its report didn't fit the queue; loop() retries
+  bool key_state_dirty_{false};
+  // Active hold() count per key (usages, then the 8 modifiers)
+  uint8_t hold_refs_[NKRO_MAX_KEY + 1 + 8]{0};
+  uint32_t timed_epoch_{0};
+
+  // Macro player: macro_queue_[0] is playing, macro_pc_ is the offset of its
+  // current step and macro_text_pos_ the progress inside a TYPE step.
+  struct PendingMacro {
+    const uint8_t *steps;
+    size_t len;
+  };
+  PendingMacro macro_queue_[MACRO_QUEUE_SIZE + 1];
+  uint8_t macro_count_{0};
+  size_t macro_pc_{0};
+  size_t macro_text_pos_{0};
+
+  // send_string() text in order; pos is how far it has been typed. Text stays
+  // on the hosts it was sent to, even if the selection changes meanwhile.
+  struct PendingText {
+    std::string text;
+    size_t pos;
+    uint8_t hosts;
+    size_t unmapped;
+  };
+  std::deque<PendingText> pending_text_;
+
+  // Paste ring buffer, allocated on first use
+  std::unique_ptr<char[]> paste_buf_;
+  size_t paste_size_{512};
+  size_t paste_head_{0};
+  size_t paste_tail_{0};
+  size_t paste_count_{0};
+  bool paste_active_{false};
+  bool paste_ended_{false};
+  bool pasting_{false};  // advance_paste_() is queuing; tags its reports
+  // Keys the paste has packed but not queued yet. Separate from packer_, so
+  // text typed while the paste waits for queue room never joins its report.
+  KeyReportPacker paste_packer_;
+  uint32_t paste_chars_{0};
+  uint32_t paste_start_ms_{0};
+
+  // Host slots and routing
+  HostLink hosts_[MAX_HOSTS];
+  std::atomic<uint8_t> selected_host_{0};
+  bool broadcast_{false};
+  uint8_t route_override_{0};  // host mask for send_string_to, 0 = none
+  uint16_t min_report_interval_ms_{10};
+
+  // Low-latency typing mode
+  bool low_latency_{false};
+  uint8_t fast_hosts_{0};  // hosts currently asked for fast_interval_
+  uint16_t fast_interval_{6};
+  uint16_t idle_interval_{36};
+  uint16_t idle_latency_{4};
+  uint32_t idle_timeout_ms_{2000};
+
+  BondInfo bonds_[MAX_BONDS]{};
+  uint8_t bond_count_{0};
+
+  BtStartup startup_step_{BtStartup::NVS};
+  uint32_t startup_begin_ms_{0};
+  std::atomic<uint32_t> advertising_ms_{0};  // first advertising start, 0 = not yet
+
+  std::string device_name_{"ESP32 BLE Keyboard"};
+  esp_power_level_t tx_power_{};
+  bool has_tx_power_{false};
+  uint16_t adv_fast_interval_{0x20};   // 20 ms
+  uint16_t adv_slow_interval_{0x640};  // 1 s
+  uint32_t adv_fast_duration_ms_{30000};
+  bool adv_slow_{false};
+  uint32_t adv_fast_since_ms_{0};
+  std::atomic<bool> adv_burst_pending_{false};
+  std::atomic<bool> adv_resume_pending_{false};
+
+  // Fast reconnect. The Bluedroid task records the host that left and raises
+  // reconnect_pending_; loop() steps through the advertising phases.
+  bool fast_reconnect_{false};
+  uint32_t whitelist_ms_{10000};
+  AdvPhase adv_phase_{AdvPhase::OFF};
+  uint32_t adv_phase_ms_{0};
+  uint32_t disconnect_ms_{0};
+  esp_bd_addr_t last_host_bda_{0};  // identity address
+  std::atomic<bool> reconnect_pending_{false};
+  std::atomic<uint32_t> connect_count_{0};
+  uint32_t phase_connect_count_{0};
+
+  std::atomic<uint32_t> notifications_sent_{0};
+  std::atomic<uint32_t> notifications_retried_{0};
+  std::atomic<uint32_t> notifications_dropped_{0};
+  std::atomic<uint32_t> congestion_events_{0};
+  size_t queue_high_water_{0};
+  std::atomic<uint32_t> latency_hist_[LATENCY_BUCKET_COUNT]{};
+  std::atomic<int8_t> rssi_{0};
+  std::atomic<bool> rssi_updated_{false};
+#ifdef USE_SENSOR
+  uint32_t telemetry_interval_ms_{60000};
+  uint32_t last_telemetry_ms_{0};
+  sensor::Sensor *notifications_sent_sensor_{nullptr};
+  sensor::Sensor *notifications_failed_sensor_{nullptr};
+  sensor::Sensor *notifications_dropped_sensor_{nullptr};
+  sensor::Sensor *congestion_events_sensor_{nullptr};
+  sensor::Sensor *queue_high_water_sensor_{nullptr};
+  sensor::Sensor *latency_p50_sensor_{nullptr};
+  sensor::Sensor *latency_p95_sensor_{nullptr};
+  sensor::Sensor *conn_interval_sensor_{nullptr};
+  sensor::Sensor *mtu_sensor_{nullptr};
+  sensor::Sensor *rssi_sensor_{nullptr};
+#endif
+
+  uint8_t published_leds_{0xFF};
+#ifdef USE_BINARY_SENSOR
+  binary_sensor::BinarySensor *num_lock_binary_sensor_{nullptr};
+  binary_sensor::BinarySensor *caps_lock_binary_sensor_{nullptr};
+  binary_sensor::BinarySensor *scroll_lock_binary_sensor_{nullptr};
+#endif
+
+
   uint32_t passkey_{0};
   bool has_passkey_{false};
 };
 
+// Button actions, resolved by button.py at codegen time so a press needs no
+// string parsing.
+enum class ButtonActionType : uint8_t {
+  TEXT,
+  KEY_COMBO,
+  CONSUMER,
+  CTRL_ALT_DEL,
+  SLEEP,
+  SHUTDOWN,
+  HIBERNATE,
+  POWER,
+  PLAY_PAUSE,
+  NEXT_TRACK,
+  PREV_TRACK,
+  STOP,
+  VOLUME_UP,
+  VOLUME_DOWN,
+  MUTE,
+  MACRO,
+};
+
 class EspidfBleKeyboardButton : public button::Button, public Component {
  public:
   void set_parent(EspidfBleKeyboard *parent) { parent_ = parent; }
   void press_action() override;
-  void set_action(const std::string &action) { action_ = action; }
+
+  void set_action_type(ButtonActionType type) { type_ = type; }
+  // text points at a string literal emitted by codegen (lives in flash)
+  void set_text(const char *text) {
+    type_ = ButtonActionType::TEXT;
+    text_ = text;
+  }
+  void set_key_combo(uint8_t modifiers, uint8_t keycode) {
+    type_ = ButtonActionType::KEY_COMBO;
+    modifiers_ = modifiers;
+    keycode_ = keycode;
+  }
+  void set_consumer(uint16_t usage) {
+    type_ = ButtonActionType::CONSUMER;
+    usage_ = usage;
+  }
+  // steps is a flash-resident array emitted by codegen
+  void set_macro(const uint8_t *steps, size_t len) {
+    type_ = ButtonActionType::MACRO;
+    macro_ = steps;
+    macro_len_ = len;
+  }
+
  protected:
   EspidfBleKeyboard *parent_{nullptr};
-  std::string action_;
+  ButtonActionType type_{ButtonActionType::TEXT};
+  uint8_t modifiers_{0};
+  uint8_t keycode_{0};
+  uint16_t usage_{0};
+  const char *text_{""};
+  const uint8_t *macro_{nullptr};
+  size_t macro_len_{0};
 };
 
 }  // namespace espidf_ble_keyboard
@@ -0,0 +1,528 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace espidf_ble_keyboard {
+
+// ── HID Keyboard Usage IDs ───────────────────────────────────────────────────
+static constexpr uint8_t KEY_MOD_LCTRL  = 0x01;
+static constexpr uint8_t KEY_MOD_LSHIFT = 0x02;
+static constexpr uint8_t KEY_MOD_LALT   = 0x04;
+static constexpr uint8_t KEY_MOD_LGUI   = 0x08;
+static constexpr uint8_t KEY_MOD_RALT   = 0x40;  // AltGr on international layouts
+
+static constexpr uint8_t KEY_A          = 0x04;
+static constexpr uint8_t KEY_1          = 0x1E;
+static constexpr uint8_t KEY_0          = 0x27;
+static constexpr uint8_t KEY_ENTER      = 0x28;
+static constexpr uint8_t KEY_ESC        = 0x29;
+static constexpr uint8_t KEY_BACKSPACE  = 0x2A;
+static constexpr uint8_t KEY_TAB        = 0x2B;
+static constexpr uint8_t KEY_SPACE      = 0x2C;
+static constexpr uint8_t KEY_MINUS      = 0x2D;
+static constexpr uint8_t KEY_EQUAL      = 0x2E;
+static constexpr uint8_t KEY_LEFTBRACE  = 0x2F;
+static constexpr uint8_t KEY_RIGHTBRACE = 0x30;
+static constexpr uint8_t KEY_BACKSLASH  = 0x31;
+static constexpr uint8_t KEY_NONUS_HASH = 0x32;  // ISO key left of Enter
+static constexpr uint8_t KEY_SEMICOLON  = 0x33;
+static constexpr uint8_t KEY_APOSTROPHE = 0x34;
+static constexpr uint8_t KEY_GRAVE      = 0x35;
+static constexpr uint8_t KEY_COMMA      = 0x36;
+static constexpr uint8_t KEY_DOT        = 0x37;
+static constexpr uint8_t KEY_SLASH      = 0x38;
+static constexpr uint8_t KEY_R          = 0x15;
+static constexpr uint8_t KEY_DELETE     = 0x4C;
+static constexpr uint8_t KEY_NONUS_BACKSLASH = 0x64;  // ISO key left of Z
+
+// One keystroke: modifier bits plus a single usage. keycode 0 means the
+// character has no mapping.
+struct KeyStroke {
+  uint8_t modifier;
+  uint8_t keycode;
+};
+
+// Character → keystroke table for the 7-bit ASCII range, indexed by the
+// character value.
+struct AsciiKeymap {
+  KeyStroke keys[128];
+};
+
+// A character that is not in the ASCII table, or that needs a dead key:
+// when dead.keycode is set, dead is pressed and released before key.
+struct ExtendedKey {
+  uint16_t codepoint;
+  KeyStroke dead;
+  KeyStroke key;
+};
+
+// Everything needed to type one character on the selected layout.
+struct CharMapping {
+  KeyStroke dead;
+  KeyStroke key;
+};
+
+// Usage of the key in the given US position ('a'..'z' / 0..9); layouts
+// describe their characters by the physical key they live on.
+constexpr uint8_t letter(char c) { return (uint8_t) (KEY_A + (c - 'a')); }
+constexpr uint8_t digit(int n) { return n == 0 ? KEY_0 : (uint8_t) (KEY_1 + n - 1); }
+
+constexpr void set_letter(AsciiKeymap &m, char c, uint8_t keycode) {
+  m.keys[(uint8_t) c] = {0, keycode};
+  m.keys[(uint8_t) (c - 'a' + 'A')] = {KEY_MOD_LSHIFT, keycode};
+}
+
+// Letters, digits and control keys in their US positions; each layout
+// applies its own letter swaps and punctuation on top.
+constexpr AsciiKeymap make_base_keymap() {
+  AsciiKeymap m{};
+  for (int i = 0; i < 26; i++)
+    set_letter(m, (char) ('a' + i), (uint8_t) (KEY_A + i));
+  for (int i = 0; i < 10; i++)
+    m.keys['0' + i] = {0, digit(i)};
+  m.keys['\b'] = {0, KEY_BACKSPACE};
+  m.keys['\t'] = {0, KEY_TAB};
+  m.keys['\n'] = {0, KEY_ENTER};
+  m.keys[0x1B] = {0, KEY_ESC};
+  m.keys[0x7F] = {0, KEY_DELETE};
+  m.keys[' ']  = {0, KEY_SPACE};
+  return m;
+}
+
+// ── US Layout ────────────────────────────────────────────────────────────────
+constexpr AsciiKeymap make_us_keymap() {
+  AsciiKeymap m = make_base_keymap();
+  // Shifted digit row, in key order 1..0
+  const char digit_shift[] = "!@#$%^&*()";
+  for (int i = 0; i < 10; i++)
+    m.keys[(uint8_t) digit_shift[i]] = {KEY_MOD_LSHIFT, (uint8_t) (KEY_1 + i)};
+
+  m.keys['-']  = {0, KEY_MINUS};      m.keys['_'] = {KEY_MOD_LSHIFT, KEY_MINUS};
+  m.keys['=']  = {0, KEY_EQUAL};      m.keys['+'] = {KEY_MOD_LSHIFT, KEY_EQUAL};
+  m.keys['[']  = {0, KEY_LEFTBRACE};  m.keys['{'] = {KEY_MOD_LSHIFT, KEY_LEFTBRACE};
+  m.keys[']']  = {0, KEY_RIGHTBRACE}; m.keys['}'] = {KEY_MOD_LSHIFT, KEY_RIGHTBRACE};
+  m.keys['\\'] = {0, KEY_BACKSLASH};  m.keys['|'] = {KEY_MOD_LSHIFT, KEY_BACKSLASH};
+  m.keys[';']  = {0, KEY_SEMICOLON};  m.keys[':'] = {KEY_MOD_LSHIFT, KEY_SEMICOLON};
+  m.keys['\''] = {0, KEY_APOSTROPHE}; m.keys['"'] = {KEY_MOD_LSHIFT, KEY_APOSTROPHE};
+  m.keys['`']  = {0, KEY_GRAVE};      m.keys['~'] = {KEY_MOD_LSHIFT, KEY_GRAVE};
+  m.keys[',']  = {0, KEY_COMMA};      m.keys['<'] = {KEY_MOD_LSHIFT, KEY_COMMA};
+  m.keys['.']  = {0, KEY_DOT};        m.keys['>'] = {KEY_MOD_LSHIFT, KEY_DOT};
+  m.keys['/']  = {0, KEY_SLASH};      m.keys['?'] = {KEY_MOD_LSHIFT, KEY_SLASH};
+  return m;
+}
+
+// ── Layout Selection ─────────────────────────────────────────────────────────
+// Exactly one layout is compiled in, chosen by the `layout:` option (which
+// sets ESPIDF_BLE_KEYBOARD_LAYOUT_<NAME>); the rest cost no flash.
+// Extended tables must stay sorted by codepoint.
+#if defined(ESPIDF_BLE_KEYBOARD_LAYOUT_DE)
+// German (QWERTZ). ´ ` ^ are dead keys.
+static constexpr const char *LAYOUT_NAME = "de";
+
+constexpr AsciiKeymap make_layout_keymap() {
+  AsciiKeymap m = make_base_keymap();
+  set_letter(m, 'y', letter('z'));
+  set_letter(m, 'z', letter('y'));
+  m.keys['!'] = {KEY_MOD_LSHIFT, digit(1)};
+  m.keys['"'] = {KEY_MOD_LSHIFT, digit(2)};
+  m.keys['$'] = {KEY_MOD_LSHIFT, digit(4)};
+  m.keys['%'] = {KEY_MOD_LSHIFT, digit(5)};
+  m.keys['&'] = {KEY_MOD_LSHIFT, digit(6)};
+  m.keys['/'] = {KEY_MOD_LSHIFT, digit(7)};
+  m.keys['('] = {KEY_MOD_LSHIFT, digit(8)};
+  m.keys[')'] = {KEY_MOD_LSHIFT, digit(9)};
+  m.keys['='] = {KEY_MOD_LSHIFT, KEY_0};
+  m.keys['{'] = {KEY_MOD_RALT, digit(7)};
+  m.keys['['] = {KEY_MOD_RALT, digit(8)};
+  m.keys[']'] = {KEY_MOD_RALT, digit(9)};
+  m.keys['}'] = {KEY_MOD_RALT, KEY_0};
+  m.keys['?'] = {KEY_MOD_LSHIFT, KEY_MINUS};
+  m.keys['\\'] = {KEY_MOD_RALT, KEY_MINUS};
+  m.keys['+'] = {0, KEY_RIGHTBRACE};
+  m.keys['*'] = {KEY_MOD_LSHIFT, KEY_RIGHTBRACE};
+  m.keys['~'] = {KEY_MOD_RALT, KEY_RIGHTBRACE};
+  m.keys['#'] = {0, KEY_NONUS_HASH};
+  m.keys['\''] = {KEY_MOD_LSHIFT, KEY_NONUS_HASH};
+  m.keys[','] = {0, KEY_COMMA};
+  m.keys[';'] = {KEY_MOD_LSHIFT, KEY_COMMA};
+  m.keys['.'] = {0, KEY_DOT};
+  m.keys[':'] = {KEY_MOD_LSHIFT, KEY_DOT};
+  m.keys['-'] = {0, KEY_SLASH};
+  m.keys['_'] = {KEY_MOD_LSHIFT, KEY_SLASH};
+  m.keys['<'] = {0, KEY_NONUS_BACKSLASH};
+  m.keys['>'] = {KEY_MOD_LSHIFT, KEY_NONUS_BACKSLASH};
+  m.keys['|'] = {KEY_MOD_RALT, KEY_NONUS_BACKSLASH};
+  m.keys['@'] = {KEY_MOD_RALT, letter('q')};
+  return m;
+}
+
+static constexpr ExtendedKey LAYOUT_EXTENDED[] = {
+    {'^', {0, KEY_GRAVE}, {0, KEY_SPACE}},
+    {'`', {KEY_MOD_LSHIFT, KEY_EQUAL}, {0, KEY_SPACE}},
+    {0x00A0, {0, 0}, {0, KEY_SPACE}},  // no-break space
+    {0x00A7, {0, 0}, {KEY_MOD_LSHIFT, digit(3)}},  // §
+    {0x00B0, {0, 0}, {KEY_MOD_LSHIFT, KEY_GRAVE}},  // °
+    {0x00B2, {0, 0}, {KEY_MOD_RALT, digit(2)}},  // ²
+    {0x00B3, {0, 0}, {KEY_MOD_RALT, digit(3)}},  // ³
+    {0x00B4, {0, KEY_EQUAL}, {0, KEY_SPACE}},  // ´
+    {0x00B5, {0, 0}, {KEY_MOD_RALT, letter('m')}},  // µ
+    {0x00C0, {KEY_MOD_LSHIFT, KEY_EQUAL}, {KEY_MOD_LSHIFT, letter('a')}},  // À
+    {0x00C1, {0, KEY_EQUAL}, {KEY_MOD_LSHIFT, letter('a')}},  // Á
+    {0x00C2, {0, KEY_GRAVE}, {KEY_MOD_LSHIFT, letter('a')}},  // Â
+    {0x00C4, {0, 0}, {KEY_MOD_LSHIFT, KEY_APOSTROPHE}},  // Ä
+    {0x00C8, {KEY_MOD_LSHIFT, KEY_EQUAL}, {KEY_MOD_LSHIFT, letter('e')}},  // È
+    {0x00C9, {0, KEY_EQUAL}, {KEY_MOD_LSHIFT, letter('e')}},  // É
+    {0x00CA, {0, KEY_GRAVE}, {KEY_MOD_LSHIFT, letter('e')}},  // Ê
+    {0x00CD, {0, KEY_EQUAL}, {KEY_MOD_LSHIFT, letter('i')}},  // Í
+    {0x00CE, {0, KEY_GRAVE}, {KEY_MOD_LSHIFT, letter('i')}},  // Î
+    {0x00D3, {0, KEY_EQUAL}, {KEY_MOD_LSHIFT, letter('o')}},  // Ó
+    {0x00D4, {0, KEY_GRAVE}, {KEY_MOD_LSHIFT, letter('o')}},  // Ô
+    {0x00D6, {0, 0}, {KEY_MOD_LSHIFT, KEY_SEMICOLON}},  // Ö
+    {0x00DA, {0, KEY_EQUAL}, {KEY_MOD_LSHIFT, letter('u')}},  // Ú
+    {0x00DB, {0, KEY_GRAVE}, {KEY_MOD_LSHIFT, letter('u')}},  // Û
+    {0x00DC, {0, 0}, {KEY_MOD_LSHIFT, KEY_LEFTBRACE}},  // Ü
+    {0x00DF, {0, 0}, {0, KEY_MINUS}},  // ß
+    {0x00E0, {KEY_MOD_LSHIFT, KEY_EQUAL}, {0, letter('a')}},  // à
+    {0x00E1, {0, KEY_EQUAL}, {0, letter('a')}},  // á
+    {0x00E2, {0, KEY_GRAVE}, {0, letter('a')}},  // â
+    {0x00E4, {0, 0}, {0, KEY_APOSTROPHE}},  // ä
+    {0x00E8, {KEY_MOD_LSHIFT, KEY_EQUAL}, {0, letter('e')}},  // è
+    {0x00E9, {0, KEY_EQUAL}, {0, letter('e')}},  // é
+    {0x00EA, {0, KEY_GRAVE}, {0, letter('e')}},  // ê
+    {0x00EC, {KEY_MOD_LSHIFT, KEY_EQUAL}, {0, letter('i')}},  // ì
+    {0x00ED, {0, KEY_EQUAL}, {0, letter('i')}},  // í
+    {0x00EE, {0, KEY_GRAVE}, {0, letter('i')}},  // î
+    {0x00F2, {KEY_MOD_LSHIFT, KEY_EQUAL}, {0, letter('o')}},  // ò
+    {0x00F3, {0, KEY_EQUAL}, {0, letter('o')}},  // ó
+    {0x00F4, {0, KEY_GRAVE}, {0, letter('o')}},  // ô
+    {0x00F6, {0, 0}, {0, KEY_SEMICOLON}},  // ö
+    {0x00F9, {KEY_MOD_LSHIFT, KEY_EQUAL}, {0, letter('u')}},  // ù
+    {0x00FA, {0, KEY_EQUAL}, {0, letter('u')}},  // ú
+    {0x00FB, {0, KEY_GRAVE}, {0, letter('u')}},  // û
+    {0x00FC, {0, 0}, {0, KEY_LEFTBRACE}},  // ü
+    {0x20AC, {0, 0}, {KEY_MOD_RALT, letter('e')}},  // €
+};
+
+#elif defined(ESPIDF_BLE_KEYBOARD_LAYOUT_FR)
+// French (AZERTY). Digits need Shift; ^ ¨ and AltGr ` ~ are dead keys.
+static constexpr const char *LAYOUT_NAME = "fr";
+
+constexpr AsciiKeymap make_layout_keymap() {
+  AsciiKeymap m = make_base_keymap();
+  set_letter(m, 'a', letter('q'));
+  set_letter(m, 'q', letter('a'));
+  set_letter(m, 'z', letter('w'));
+  set_letter(m, 'w', letter('z'));
+  set_letter(m, 'm', KEY_SEMICOLON);
+  for (int i = 0; i < 10; i++)
+    m.keys['0' + i] = {KEY_MOD_LSHIFT, digit(i)};
+  m.keys['&'] = {0, digit(1)};
+  m.keys['"'] = {0, digit(3)};
+  m.keys['\''] = {0, digit(4)};
+  m.keys['('] = {0, digit(5)};
+  m.keys['-'] = {0, digit(6)};
+  m.keys['_'] = {0, digit(8)};
+  m.keys['#'] = {KEY_MOD_RALT, digit(3)};
+  m.keys['{'] = {KEY_MOD_RALT, digit(4)};
+  m.keys['['] = {KEY_MOD_RALT, digit(5)};
+  m.keys['|'] = {KEY_MOD_RALT, digit(6)};
+  m.keys['\\'] = {KEY_MOD_RALT, digit(8)};
+  m.keys['@'] = {KEY_MOD_RALT, KEY_0};
+  m.keys[')'] = {0, KEY_MINUS};
+  m.keys[']'] = {KEY_MOD_RALT, KEY_MINUS};
+  m.keys['='] = {0, KEY_EQUAL};
+  m.keys['+'] = {KEY_MOD_LSHIFT, KEY_EQUAL};
+  m.keys['}'] = {KEY_MOD_RALT, KEY_EQUAL};
+  m.keys['$'] = {0, KEY_RIGHTBRACE};
+  m.keys['*'] = {0, KEY_NONUS_HASH};
+  m.keys['%'] = {KEY_MOD_LSHIFT, KEY_APOSTROPHE};
+  m.keys[','] = {0, letter('m')};
+  m.keys['?'] = {KEY_MOD_LSHIFT, letter('m')};
+  m.keys[';'] = {0, KEY_COMMA};
+  m.keys['.'] = {KEY_MOD_LSHIFT, KEY_COMMA};
+  m.keys[':'] = {0, KEY_DOT};
+  m.keys['/'] = {KEY_MOD_LSHIFT, KEY_DOT};
+  m.keys['!'] = {0, KEY_SLASH};
+  m.keys['<'] = {0, KEY_NONUS_BACKSLASH};
+  m.keys['>'] = {KEY_MOD_LSHIFT, KEY_NONUS_BACKSLASH};
+  return m;
+}
+
+static constexpr ExtendedKey LAYOUT_EXTENDED[] = {
+    {'^', {0, KEY_LEFTBRACE}, {0, KEY_SPACE}},
+    {'`', {KEY_MOD_RALT, digit(7)}, {0, KEY_SPACE}},
+    {'~', {KEY_MOD_RALT, digit(2)}, {0, KEY_SPACE}},
+    {0x00A0, {0, 0}, {0, KEY_SPACE}},  // no-break space
+    {0x00A3, {0, 0}, {KEY_MOD_LSHIFT, KEY_RIGHTBRACE}},  // £
+    {0x00A4, {0, 0}, {KEY_MOD_RALT, KEY_RIGHTBRACE}},  // ¤
+    {0x00A7, {0, 0}, {KEY_MOD_LSHIFT, KEY_SLASH}},  // §
+    {0x00A8, {KEY_MOD_LSHIFT, KEY_LEFTBRACE}, {0, KEY_SPACE}},  // ¨
+    {0x00B0, {0, 0}, {KEY_MOD_LSHIFT, KEY_MINUS}},  // °
+    {0x00B2, {0, 0}, {0, KEY_GRAVE}},  // ²
+    {0x00B5, {0, 0}, {KEY_MOD_LSHIFT, KEY_NONUS_HASH}},  // µ
+    {0x00C2, {0, KEY_LEFTBRACE}, {KEY_MOD_LSHIFT, letter('q')}},  // Â
+    {0x00C4, {KEY_MOD_LSHIFT, KEY_LEFTBRACE}, {KEY_MOD_LSHIFT, letter('q')}},  // Ä
+    {0x00CA, {0, KEY_LEFTBRACE}, {KEY_MOD_LSHIFT, letter('e')}},  // Ê
+    {0x00CB, {KEY_MOD_LSHIFT, KEY_LEFTBRACE}, {KEY_MOD_LSHIFT, letter('e')}},  // Ë
+    {0x00CE, {0, KEY_LEFTBRACE}, {KEY_MOD_LSHIFT, letter('i')}},  // Î
+    {0x00CF, {KEY_MOD_LSHIFT, KEY_LEFTBRACE}, {KEY_MOD_LSHIFT, letter('i')}},  // Ï
+    {0x00D1, {KEY_MOD_RALT, digit(2)}, {KEY_MOD_LSHIFT, letter('n')}},  // Ñ
+    {0x00D4, {0, KEY_LEFTBRACE}, {KEY_MOD_LSHIFT, letter('o')}},  // Ô
+    {0x00D6, {KEY_MOD_LSHIFT, KEY_LEFTBRACE}, {KEY_MOD_LSHIFT, letter('o')}},  // Ö
+    {0x00DB, {0, KEY_LEFTBRACE}, {KEY_MOD_LSHIFT, letter('u')}},  // Û
+    {0x00DC, {KEY_MOD_LSHIFT, KEY_LEFTBRACE}, {KEY_MOD_LSHIFT, letter('u')}},  // Ü
+    {0x00E0, {0, 0}, {0, KEY_0}},  // à
+    {0x00E2, {0, KEY_LEFTBRACE}, {0, letter('q')}},  // â
+    {0x00E4, {KEY_MOD_LSHIFT, KEY_LEFTBRACE}, {0, letter('q')}},  // ä
+    {0x00E7, {0, 0}, {0, digit(9)}},  // ç
+    {0x00E8, {0, 0}, {0, digit(7)}},  // è
+    {0x00E9, {0, 0}, {0, digit(2)}},  // é
+    {0x00EA, {0, KEY_LEFTBRACE}, {0, letter('e')}},  // ê
+    {0x00EB, {KEY_MOD_LSHIFT, KEY_LEFTBRACE}, {0, letter('e')}},  // ë
+    {0x00EE, {0, KEY_LEFTBRACE}, {0, letter('i')}},  // î
+    {0x00EF, {KEY_MOD_LSHIFT, KEY_LEFTBRACE}, {0, letter('i')}},  // ï
+    {0x00F1, {KEY_MOD_RALT, digit(2)}, {0, letter('n')}},  // ñ
+    {0x00F4, {0, KEY_LEFTBRACE}, {0, letter('o')}},  // ô
+    {0x00F6, {KEY_MOD_LSHIFT, KEY_LEFTBRACE}, {0, letter('o')}},  // ö
+    {0x00F9, {0, 0}, {0, KEY_APOSTROPHE}},  // ù
+    {0x00FB, {0, KEY_LEFTBRACE}, {0, letter('u')}},  // û
+    {0x00FC, {KEY_MOD_LSHIFT, KEY_LEFTBRACE}, {0, letter('u')}},  // ü
+    {0x00FF, {KEY_MOD_LSHIFT, KEY_LEFTBRACE}, {0, letter('y')}},  // ÿ
+    {0x20AC, {0, 0}, {KEY_MOD_RALT, letter('e')}},  // €
+};
+
+#elif defined(ESPIDF_BLE_KEYBOARD_LAYOUT_UK)
+// United Kingdom (ISO QWERTY). AltGr + vowel gives the acute accents.
+static constexpr const char *LAYOUT_NAME = "uk";
+
+constexpr AsciiKeymap make_layout_keymap() {
+  AsciiKeymap m = make_us_keymap();
+  m.keys['"'] = {KEY_MOD_LSHIFT, digit(2)};
+  m.keys['@'] = {KEY_MOD_LSHIFT, KEY_APOSTROPHE};
+  m.keys['#'] = {0, KEY_NONUS_HASH};
+  m.keys['~'] = {KEY_MOD_LSHIFT, KEY_NONUS_HASH};
+  m.keys['\\'] = {0, KEY_NONUS_BACKSLASH};
+  m.keys['|'] = {KEY_MOD_LSHIFT, KEY_NONUS_BACKSLASH};
+  return m;
+}
+
+static constexpr ExtendedKey LAYOUT_EXTENDED[] = {
+    {0x00A0, {0, 0}, {0, KEY_SPACE}},  // no-break space
+    {0x00A3, {0, 0}, {KEY_MOD_LSHIFT, digit(3)}},  // £
+    {0x00AC, {0, 0}, {KEY_MOD_LSHIFT, KEY_GRAVE}},  // ¬
+    {0x00C1, {0, 0}, {KEY_MOD_RALT | KEY_MOD_LSHIFT, letter('a')}},  // Á
+    {0x00C9, {0, 0}, {KEY_MOD_RALT | KEY_MOD_LSHIFT, letter('e')}},  // É
+    {0x00CD, {0, 0}, {KEY_MOD_RALT | KEY_MOD_LSHIFT, letter('i')}},  // Í
+    {0x00D3, {0, 0}, {KEY_MOD_RALT | KEY_MOD_LSHIFT, letter('o')}},  // Ó
+    {0x00DA, {0, 0}, {KEY_MOD_RALT | KEY_MOD_LSHIFT, letter('u')}},  // Ú
+    {0x00E1, {0, 0}, {KEY_MOD_RALT, letter('a')}},  // á
+    {0x00E9, {0, 0}, {KEY_MOD_RALT, letter('e')}},  // é
+    {0x00ED, {0, 0}, {KEY_MOD_RALT, letter('i')}},  // í
+    {0x00F3, {0, 0}, {KEY_MOD_RALT, letter('o')}},  // ó
+    {0x00FA, {0, 0}, {KEY_MOD_RALT, letter('u')}},  // ú
+    {0x20AC, {0, 0}, {KEY_MOD_RALT, digit(4)}},  // €
+};
+
+#elif defined(ESPIDF_BLE_KEYBOARD_LAYOUT_NORDIC)
+// Swedish / Finnish. ´ ` ¨ ^ and AltGr ~ are dead keys.
+static constexpr const char *LAYOUT_NAME = "nordic";
+
+constexpr AsciiKeymap make_layout_keymap() {
+  AsciiKeymap m = make_base_keymap();
+  m.keys['!'] = {KEY_MOD_LSHIFT, digit(1)};
+  m.keys['"'] = {KEY_MOD_LSHIFT, digit(2)};
+  m.keys['#'] = {KEY_MOD_LSHIFT, digit(3)};
+  m.keys['%'] = {KEY_MOD_LSHIFT, digit(5)};
+  m.keys['&'] = {KEY_MOD_LSHIFT, digit(6)};
+  m.keys['/'] = {KEY_MOD_LSHIFT, digit(7)};
+  m.keys['('] = {KEY_MOD_LSHIFT, digit(8)};
+  m.keys[')'] = {KEY_MOD_LSHIFT, digit(9)};
+  m.keys['='] = {KEY_MOD_LSHIFT, KEY_0};
+  m.keys['@'] = {KEY_MOD_RALT, digit(2)};
+  m.keys['$'] = {KEY_MOD_RALT, digit(4)};
+  m.keys['{'] = {KEY_MOD_RALT, digit(7)};
+  m.keys['['] = {KEY_MOD_RALT, digit(8)};
+  m.keys[']'] = {KEY_MOD_RALT, digit(9)};
+  m.keys['}'] = {KEY_MOD_RALT, KEY_0};
+  m.keys['+'] = {0, KEY_MINUS};
+  m.keys['?'] = {KEY_MOD_LSHIFT, KEY_MINUS};
+  m.keys['\\'] = {KEY_MOD_RALT, KEY_MINUS};
+  m.keys['\''] = {0, KEY_NONUS_HASH};
+  m.keys['*'] = {KEY_MOD_LSHIFT, KEY_NONUS_HASH};
+  m.keys[','] = {0, KEY_COMMA};
+  m.keys[';'] = {KEY_MOD_LSHIFT, KEY_COMMA};
+  m.keys['.'] = {0, KEY_DOT};
+  m.keys[':'] = {KEY_MOD_LSHIFT, KEY_DOT};
+  m.keys['-'] = {0, KEY_SLASH};
+  m.keys['_'] = {KEY_MOD_LSHIFT, KEY_SLASH};
+  m.keys['<'] = {0, KEY_NONUS_BACKSLASH};
+  m.keys['>'] = {KEY_MOD_LSHIFT, KEY_NONUS_BACKSLASH};
+  m.keys['|'] = {KEY_MOD_RALT, KEY_NONUS_BACKSLASH};
+  return m;
+}
+
+static constexpr ExtendedKey LAYOUT_EXTENDED[] = {
+    {'^', {KEY_MOD_LSHIFT, KEY_RIGHTBRACE}, {0, KEY_SPACE}},
+    {'`', {KEY_MOD_LSHIFT, KEY_EQUAL}, {0, KEY_SPACE}},
+    {'~', {KEY_MOD_RALT, KEY_RIGHTBRACE}, {0, KEY_SPACE}},
+    {0x00A0, {0, 0}, {0, KEY_SPACE}},  // no-break space
+    {0x00A3, {0, 0}, {KEY_MOD_RALT, digit(3)}},  // £
+    {0x00A4, {0, 0}, {KEY_MOD_LSHIFT, digit(4)}},  // ¤
+    {0x00A7, {0, 0}, {0, KEY_GRAVE}},  // §
+    {0x00A8, {0, KEY_RIGHTBRACE}, {0, KEY_SPACE}},  // ¨
+    {0x00B4, {0, KEY_EQUAL}, {0, KEY_SPACE}},  // ´
+    {0x00B5, {0, 0}, {KEY_MOD_RALT, letter('m')}},  // µ
+    {0x00BD, {0, 0}, {KEY_MOD_LSHIFT, KEY_GRAVE}},  // ½
+    {0x00C0, {KEY_MOD_LSHIFT, KEY_EQUAL}, {KEY_MOD_LSHIFT, letter('a')}},  // À
+    {0x00C1, {0, KEY_EQUAL}, {KEY_MOD_LSHIFT, letter('a')}},  // Á
+    {0x00C4, {0, 0}, {KEY_MOD_LSHIFT, KEY_APOSTROPHE}},  // Ä
+    {0x00C5, {0, 0}, {KEY_MOD_LSHIFT, KEY_LEFTBRACE}},  // Å
+    {0x00C8, {KEY_MOD_LSHIFT, KEY_EQUAL}, {KEY_MOD_LSHIFT, letter('e')}},  // È
+    {0x00C9, {0, KEY_EQUAL}, {KEY_MOD_LSHIFT, letter('e')}},  // É
+    {0x00CA, {KEY_MOD_LSHIFT, KEY_RIGHTBRACE}, {KEY_MOD_LSHIFT, letter('e')}},  // Ê
+    {0x00CB, {0, KEY_RIGHTBRACE}, {KEY_MOD_LSHIFT, letter('e')}},  // Ë
+    {0x00CD, {0, KEY_EQUAL}, {KEY_MOD_LSHIFT, letter('i')}},  // Í
+    {0x00D1, {KEY_MOD_RALT, KEY_RIGHTBRACE}, {KEY_MOD_LSHIFT, letter('n')}},  // Ñ
+    {0x00D3, {0, KEY_EQUAL}, {KEY_MOD_LSHIFT, letter('o')}},  // Ó
+    {0x00D6, {0, 0}, {KEY_MOD_LSHIFT, KEY_SEMICOLON}},  // Ö
+    {0x00DA, {0, KEY_EQUAL}, {KEY_MOD_LSHIFT, letter('u')}},  // Ú
+    {0x00DC, {0, KEY_RIGHTBRACE}, {KEY_MOD_LSHIFT, letter('u')}},  // Ü
+    {0x00E0, {KEY_MOD_LSHIFT, KEY_EQUAL}, {0, letter('a')}},  // à
+    {0x00E1, {0, KEY_EQUAL}, {0, letter('a')}},  // á
+    {0x00E2, {KEY_MOD_LSHIFT, KEY_RIGHTBRACE}, {0, letter('a')}},  // â
+    {0x00E4, {0, 0}, {0, KEY_APOSTROPHE}},  // ä
+    {0x00E5, {0, 0}, {0, KEY_LEFTBRACE}},  // å
+    {0x00E8, {KEY_MOD_LSHIFT, KEY_EQUAL}, {0, letter('e')}},  // è
+    {0x00E9, {0, KEY_EQUAL}, {0, letter('e')}},  // é
+    {0x00EA, {KEY_MOD_LSHIFT, KEY_RIGHTBRACE}, {0, letter('e')}},  // ê
+    {0x00EB, {0, KEY_RIGHTBRACE}, {0, letter('e')}},  // ë
+    {0x00EC, {KEY_MOD_LSHIFT, KEY_EQUAL}, {0, letter('i')}},  // ì
+    {0x00ED, {0, KEY_EQUAL}, {0, letter('i')}},  // í
+    {0x00EE, {KEY_MOD_LSHIFT, KEY_RIGHTBRACE}, {0, letter('i')}},  // î
+    {0x00EF, {0, KEY_RIGHTBRACE}, {0, letter('i')}},  // ï
+    {0x00F1, {KEY_MOD_RALT, KEY_RIGHTBRACE}, {0, letter('n')}},  // ñ
+    {0x00F2, {KEY_MOD_LSHIFT, KEY_EQUAL}, {0, letter('o')}},  // ò
+    {0x00F3, {0, KEY_EQUAL}, {0, letter('o')}},  // ó
+    {0x00F4, {KEY_MOD_LSHIFT, KEY_RIGHTBRACE}, {0, letter('o')}},  // ô
+    {0x00F6, {0, 0}, {0, KEY_SEMICOLON}},  // ö
+    {0x00F9, {KEY_MOD_LSHIFT, KEY_EQUAL}, {0, letter('u')}},  // ù
+    {0x00FA, {0, KEY_EQUAL}, {0, letter('u')}},  // ú
+    {0x00FB, {KEY_MOD_LSHIFT, KEY_RIGHTBRACE}, {0, letter('u')}},  // û
+    {0x00FC, {0, KEY_RIGHTBRACE}, {0, letter('u')}},  // ü
+    {0x00FD, {0, KEY_EQUAL}, {0, letter('y')}},  // ý
+    {0x00FF, {0, KEY_RIGHTBRACE}, {0, letter('y')}},  // ÿ
+    {0x20AC, {0, 0}, {KEY_MOD_RALT, digit(5)}},  // €
+};
+
+#else
+// US (default)
+static constexpr const char *LAYOUT_NAME = "us";
+
+constexpr AsciiKeymap make_layout_keymap() { return make_us_keymap(); }
+
+static constexpr ExtendedKey LAYOUT_EXTENDED[] = {
+    {0x00A0, {0, 0}, {0, KEY_SPACE}},  // no-break space
+};
+#endif
+
+static constexpr AsciiKeymap LAYOUT_KEYMAP = make_layout_keymap();
+static constexpr size_t LAYOUT_EXTENDED_COUNT = sizeof(LAYOUT_EXTENDED) / sizeof(LAYOUT_EXTENDED[0]);
+
+// Looks up how to type a Unicode codepoint; key.keycode is 0 if the layout
+// has no way to produce it.
+constexpr CharMapping lookup_char(uint32_t codepoint) {
+  if (codepoint < 128 && LAYOUT_KEYMAP.keys[codepoint].keycode != 0)
+    return {{0, 0}, LAYOUT_KEYMAP.keys[codepoint]};
+  size_t lo = 0, hi = LAYOUT_EXTENDED_COUNT;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (LAYOUT_EXTENDED[mid].codepoint < codepoint) {
+      lo = mid + 1;
+    } else if (LAYOUT_EXTENDED[mid].codepoint > codepoint) {
+      hi = mid;
+    } else {
+      return {LAYOUT_EXTENDED[mid].dead, LAYOUT_EXTENDED[mid].key};
+    }
+  }
+  return {{0, 0}, {0, 0}};
+}
+
+// Same, for a host with Caps Lock on: letters get Shift inverted. A character
+// counts as a letter when its other case sits on the same key and differs only
+// by Shift, which covers layout keys like ä/Ä but not FR é (no É key).
+constexpr CharMapping lookup_char(uint32_t codepoint, bool caps_lock) {
+  CharMapping mapping = lookup_char(codepoint);
+  if (!caps_lock || mapping.key.keycode == 0) return mapping;
+  uint32_t other = 0;
+  if ((codepoint >= 'a' && codepoint <= 'z') || (codepoint >= 0xE0 && codepoint <= 0xFE && codepoint != 0xF7)) {
+    other = codepoint - 0x20;
+  } else if ((codepoint >= 'A' && codepoint <= 'Z') || (codepoint >= 0xC0 && codepoint <= 0xDE && codepoint != 0xD7)) {
+    other = codepoint + 0x20;
+  } else {
+    return mapping;
+  }
+  CharMapping pair = lookup_char(other);
+  if (pair.key.keycode == mapping.key.keycode && pair.dead.keycode == mapping.dead.keycode &&
+      pair.dead.modifier == mapping.dead.modifier && (pair.key.modifier ^ mapping.key.modifier) == KEY_MOD_LSHIFT) {
+    mapping.key.modifier ^= KEY_MOD_LSHIFT;
+  }
+  return mapping;
+}
+
+constexpr bool layout_extended_sorted() {
+  for (size_t i = 1; i < LAYOUT_EXTENDED_COUNT; i++) {
+    if (LAYOUT_EXTENDED[i - 1].codepoint >= LAYOUT_EXTENDED[i].codepoint) return false;
+  }
+  return true;
+}
+
+constexpr bool layout_maps_all_printable() {
+  for (uint32_t c = ' '; c <= '~'; c++) {
+    if (lookup_char(c).key.keycode == 0) return false;
+  }
+  return true;
+}
+
+// With Caps Lock on, 'a' must be typed exactly like 'A' is without it
+constexpr bool layout_caps_lock_consistent() {
+  for (uint32_t c = 'a'; c <= 'z'; c++) {
+    CharMapping caps = lookup_char(c, true);
+    CharMapping upper = lookup_char(c - 0x20);
+    if (caps.key.keycode != upper.key.keycode || caps.key.modifier != upper.key.modifier) return false;
+  }
+  return true;
+}
+
+static_assert(layout_extended_sorted(), "Extended keymap must be sorted by codepoint");
+static_assert(layout_maps_all_printable(), "Keymap must cover every printable ASCII character");
+static_assert(layout_caps_lock_consistent(), "Caps Lock must invert Shift for every letter");
+
+// Decodes one UTF-8 sequence starting at p and advances p past it. Malformed
+// input yields U+FFFD (which no layout maps) and skips a single byte.
+inline uint32_t utf8_next(const char *&p, const char *end) {
+  uint8_t c = (uint8_t) *p++;
+  if (c < 0x80) return c;
+  int extra;
+  uint32_t cp;
+  if ((c & 0xE0) == 0xC0) {
+    extra = 1; cp = c & 0x1F;
+  } else if ((c & 0xF0) == 0xE0) {
+    extra = 2; cp = c & 0x0F;
+  } else if ((c & 0xF8) == 0xF0) {
+    extra = 3; cp = c & 0x07;
+  } else {
+    return 0xFFFD;
+  }
+  if (end - p < extra) return 0xFFFD;
+  for (int i = 0; i < extra; i++) {
+    uint8_t cc = (uint8_t) p[i];
+    if ((cc & 0xC0) != 0x80) return 0xFFFD;
+    cp = (cp << 6) | (cc & 0x3F);
+  }
+  p += extra;
+  return cp;
+}
+
+}  // namespace espidf_ble_keyboard
+}  // namespace esphome
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+
+namespace esphome {
+namespace espidf_ble_keyboard {
+
+// ── Macro Bytecode ───────────────────────────────────────────────────────────
+// A macro is a flat byte array (emitted into flash by codegen, see
+// ble_keyboard_const.py) of steps, each an opcode followed by its operands.
+// Opcode values must match MACRO_OP_* in ble_keyboard_const.py.
+enum MacroOp : uint8_t {
+  MACRO_OP_TAP = 0x01,       // modifier, keycode — press then release
+  MACRO_OP_PRESS = 0x02,     // modifier, keycode — held until MACRO_OP_RELEASE
+  MACRO_OP_RELEASE = 0x03,   // release all keyboard keys
+  MACRO_OP_TYPE = 0x04,      // length, UTF-8 text (typed with the active layout)
+  MACRO_OP_DELAY = 0x05,     // milliseconds, u16 little endian
+  MACRO_OP_CONSUMER = 0x06,  // consumer usage, u16 little endian
+  MACRO_OP_SYSTEM = 0x07,    // system control usage
+};
+
+#define MACRO_U16(v) (uint8_t) ((v) & 0xFF), (uint8_t) ((v) >> 8)
+
+// How many macros can wait behind the one that is playing
+static const uint8_t MACRO_QUEUE_SIZE = 4;
+
+}  // namespace espidf_ble_keyboard
+}  // namespace esphome
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace esphome {
+namespace espidf_ble_keyboard {
+
+// ── Keystroke Packing ────────────────────────────────────────────────────────
+// Collects consecutive keystrokes into one 8-byte keyboard report. Keystrokes
+// that share a modifier and are all distinct fit in the same report (up to
+// keys_per_report slots); a repeated key or a modifier change needs the
+// pending report sent and released first, so the host still sees every
+// keystroke. Plain data with no ESP-IDF dependency, so it builds on a host.
+class KeyReportPacker {
+ public:
+  void set_keys_per_report(uint8_t keys) { keys_per_report_ = keys; }
+  uint8_t keys_per_report() const { return keys_per_report_; }
+
+  // True if the pending report has to be flushed before this key is added.
+  bool needs_flush(uint8_t modifier, uint8_t keycode) const {
+    if (count_ == 0) return false;
+    return count_ >= keys_per_report_ || report_[0] != modifier ||
+           memchr(&report_[2], keycode, count_) != nullptr;
+  }
+  void add(uint8_t modifier, uint8_t keycode) {
+    report_[0] = modifier;
+    report_[2 + count_++] = keycode;
+  }
+  void clear() {
+    memset(report_, 0, sizeof(report_));
+    count_ = 0;
+  }
+
+  const uint8_t *report() const { return report_; }
+  uint8_t size() const { return count_; }
+  bool empty() const { return count_ == 0; }
+
+ protected:
+  uint8_t report_[8]{0};
+  uint8_t count_{0};
+  uint8_t keys_per_report_{6};
+};
+
+}  // namespace espidf_ble_keyboard
+}  // namespace esphome
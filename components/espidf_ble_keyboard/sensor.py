@@ -0,0 +1,68 @@
+import esphome.codegen as cg
+import esphome.config_validation as cv
+from esphome.components import sensor
+from esphome.const import (
+    CONF_UPDATE_INTERVAL,
+    DEVICE_CLASS_SIGNAL_STRENGTH,
+    ENTITY_CATEGORY_DIAGNOSTIC,
+    STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
+    UNIT_DECIBEL_MILLIWATT,
+    UNIT_MILLISECOND,
+)
+from . import EspidfBleKeyboard
+
+DEPENDENCIES = ["espidf_ble_keyboard"]
+
+CONF_KEYBOARD_ID = "keyboard_id"
+
+
+def _counter():
+    return sensor.sensor_schema(
+        accuracy_decimals=0,
+        state_class=STATE_CLASS_TOTAL_INCREASING,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    )
+
+
+def _measurement(unit=None, decimals=0, device_class=None):
+    kwargs = {
+        "accuracy_decimals": decimals,
+        "state_class": STATE_CLASS_MEASUREMENT,
+        "entity_category": ENTITY_CATEGORY_DIAGNOSTIC,
+    }
+    if unit:
+        kwargs["unit_of_measurement"] = unit
+    if device_class:
+        kwargs["device_class"] = device_class
+    return sensor.sensor_schema(**kwargs)
+
+
+# Config key -> (setter on EspidfBleKeyboard, schema)
+TELEMETRY_SENSORS = {
+    "notifications_sent": ("set_notifications_sent_sensor", _counter()),
+    "notifications_failed": ("set_notifications_failed_sensor", _counter()),
+    "notifications_dropped": ("set_notifications_dropped_sensor", _counter()),
+    "congestion_events": ("set_congestion_events_sensor", _counter()),
+    "queue_high_water": ("set_queue_high_water_sensor", _measurement()),
+    # Enqueue to ESP_GATTS_CONF_EVT, reported as histogram bucket bounds
+    "latency_p50": ("set_latency_p50_sensor", _measurement(UNIT_MILLISECOND)),
+    "latency_p95": ("set_latency_p95_sensor", _measurement(UNIT_MILLISECOND)),
+    "connection_interval": ("set_conn_interval_sensor", _measurement(UNIT_MILLISECOND, 2)),
+    "mtu": ("set_mtu_sensor", _measurement()),
+    "rssi": ("set_rssi_sensor", _measurement(UNIT_DECIBEL_MILLIWATT, 0, DEVICE_CLASS_SIGNAL_STRENGTH)),
+}
+
+CONFIG_SCHEMA = cv.Schema({
+    cv.Required(CONF_KEYBOARD_ID): cv.use_id(EspidfBleKeyboard),
+    cv.Optional(CONF_UPDATE_INTERVAL, default="60s"): cv.positive_time_period_milliseconds,
+    **{cv.Optional(key): schema for key, (_, schema) in TELEMETRY_SENSORS.items()},
+})
+
+async def to_code(config):
+    parent = await cg.get_variable(config[CONF_KEYBOARD_ID])
+    cg.add(parent.set_telemetry_interval(config[CONF_UPDATE_INTERVAL].total_milliseconds))
+    for key, (setter, _) in TELEMETRY_SENSORS.items():
+        if key in config:
+            sens = await sensor.new_sensor(config[key])
+            cg.add(getattr(parent, setter)(sens))
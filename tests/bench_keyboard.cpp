@@ -0,0 +1,146 @@
+// Typing throughput on the mock stack. For each connection interval and
+// packing setting the corpus is typed one line at a time (each line fits the
+// report queue) and reported as:
+//   reports/s     notifications confirmed per second of virtual time
+//   notif/char    keyboard notifications per typed character
+//   encode ns/ch  wall time spent in send_string() per character
+//   block         caller blocking per send_string(): virtual ms (vTaskDelay)
+//                 and worst wall time
+// A streaming paste of the whole corpus is measured the same way.
+//   bench_keyboard [--quick]
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "harness.h"
+
+using testing::KeyboardHarness;
+
+static const char *const CORPUS[] = {
+    "The quick brown fox jumps over the lazy dog.",
+    "Hello, World! 1234567890",
+    "ssh admin@192.168.1.10 -p 2222",
+    "https://example.com/path?query=value&x=1",
+    "if (a != b) { return a * (b + c); }",
+    "Passw0rd!#$%^&*()_+-=[]{}|;':\",./<>?",
+    "aaaa bbbb cccc dddd eeee ffff gggg",
+    "Mississippi bookkeeper committee",
+    "SELECT id, name FROM users WHERE id = 42;",
+    "~`@ back\\slash tab\tand newline\n",
+};
+
+struct Result {
+  size_t chars{0};
+  size_t notifications{0};
+  uint32_t virtual_ms{0};
+  uint64_t encode_ns{0};
+  uint32_t blocked_ms{0};
+  uint64_t worst_call_ns{0};
+  bool intact{true};
+};
+
+static uint64_t wall_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static std::vector<std::string> corpus(int rounds) {
+  std::vector<std::string> lines;
+  for (int i = 0; i < rounds; i++) {
+    for (const char *line : CORPUS) lines.push_back(line);
+  }
+  return lines;
+}
+
+// Virtual time from start to the last notification sent
+static uint32_t last_sent_ms(KeyboardHarness &h, uint32_t start) {
+  return h.bt().notifications.empty() ? 0 : h.bt().notifications.back().ms - start;
+}
+
+static Result type_corpus(uint16_t interval, uint8_t keys_per_report, const std::vector<std::string> &lines) {
+  Result result;
+  KeyboardHarness h;
+  h.kb().set_keys_per_report(keys_per_report);
+  h.start();
+  uint16_t conn = h.connect(1, interval);
+  h.run_for(200);
+  std::string expected;
+  size_t before = h.bt().notifications.size();
+  uint32_t start = mock::now_ms();
+  for (const auto &line : lines) {
+    uint32_t blocked = mock::blocked_ms();
+    uint64_t t0 = wall_ns();
+    h.kb().send_string(line);
+    uint64_t spent = wall_ns() - t0;
+    result.encode_ns += spent;
+    result.worst_call_ns = std::max(result.worst_call_ns, spent);
+    result.blocked_ms += mock::blocked_ms() - blocked;
+    result.chars += line.size();
+    expected += line;
+    if (!h.run_until_idle()) result.intact = false;
+  }
+  result.virtual_ms = last_sent_ms(h, start);
+  result.notifications = h.bt().notifications.size() - before;
+  result.intact = result.intact && h.typed_text(conn) == expected;
+  return result;
+}
+
+static Result paste_corpus(uint16_t interval, const std::vector<std::string> &lines) {
+  Result result;
+  std::string text;
+  for (const auto &line : lines) text += line;
+  KeyboardHarness h;
+  h.start();
+  uint16_t conn = h.connect(1, interval);
+  h.run_for(200);
+  size_t before = h.bt().notifications.size();
+  uint32_t start = mock::now_ms();
+  // Feed it like a UART would: whatever fits, every loop
+  size_t written = 0;
+  while (written < text.size()) {
+    uint32_t blocked = mock::blocked_ms();
+    uint64_t t0 = wall_ns();
+    written += h.kb().paste_write(text.data() + written, text.size() - written);
+    uint64_t spent = wall_ns() - t0;
+    result.worst_call_ns = std::max(result.worst_call_ns, spent);
+    result.blocked_ms += mock::blocked_ms() - blocked;
+    h.run_for(KeyboardHarness::LOOP_INTERVAL_MS);
+  }
+  h.kb().paste_end();
+  result.intact = h.run_until_idle();
+  result.virtual_ms = last_sent_ms(h, start);
+  result.chars = text.size();
+  result.notifications = h.bt().notifications.size() - before;
+  result.intact = result.intact && h.typed_text(conn) == text;
+  return result;
+}
+
+static void print_row(const char *mode, uint16_t interval, const Result &r) {
+  double seconds = r.virtual_ms / 1000.0;
+  printf("%-10s %7.2f %9zu %10.1f %10.2f %12s %9u %9.1f   %s\n", mode, interval * 1.25, r.chars,
+         seconds > 0 ? r.notifications / seconds : 0.0, r.chars ? double(r.notifications) / r.chars : 0.0,
+         r.encode_ns ? std::to_string(r.encode_ns / r.chars).c_str() : "-", (unsigned) r.blocked_ms,
+         r.worst_call_ns / 1000.0, r.intact ? "ok" : "MISMATCH");
+}
+
+int main(int argc, char **argv) {
+  bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+  auto lines = corpus(quick ? 1 : 10);
+  static const uint16_t INTERVALS[] = {6, 12, 24};  // 7.5, 15 and 30 ms
+
+  printf("%-10s %7s %9s %10s %10s %12s %9s %9s   %s\n", "mode", "conn ms", "chars", "reports/s", "notif/char",
+         "encode ns/ch", "block ms", "worst us", "text");
+  bool intact = true;
+  for (uint16_t interval : INTERVALS) {
+    Result packed = type_corpus(interval, 6, lines);
+    Result single = type_corpus(interval, 1, lines);
+    Result paste = paste_corpus(interval, lines);
+    print_row("packed", interval, packed);
+    print_row("unpacked", interval, single);
+    print_row("paste", interval, paste);
+    intact = intact && packed.intact && single.intact && paste.intact;
+  }
+  return intact ? 0 : 1;
+}
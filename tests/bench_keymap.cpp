@@ -0,0 +1,57 @@
+// Cost of turning text into keystrokes on the compiled-in layout: UTF-8
+// decoding plus lookup_char(), in ns per character, for ASCII text and for
+// text that goes through the layout's extended table.
+//   bench_keymap_<layout> [--quick]
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "hid_keymap.h"
+
+using namespace esphome::espidf_ble_keyboard;
+
+static double ns_per_char(const std::string &text, int rounds, uint32_t &checksum) {
+  auto start = std::chrono::steady_clock::now();
+  size_t chars = 0;
+  for (int r = 0; r < rounds; r++) {
+    const char *p = text.data(), *end = p + text.size();
+    while (p < end) {
+      CharMapping mapping = lookup_char(utf8_next(p, end), r & 1);
+      checksum = checksum * 31 + mapping.key.keycode + mapping.key.modifier + mapping.dead.keycode;
+      chars++;
+    }
+  }
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  return chars ? double(ns) / chars : 0.0;
+}
+
+int main(int argc, char **argv) {
+  bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+  int rounds = quick ? 100 : 20000;
+
+  std::string ascii;
+  for (char c = ' '; c <= '~'; c++) ascii += c;
+  // Every codepoint of the extended table, UTF-8 encoded
+  std::string extended;
+  for (size_t i = 0; i < LAYOUT_EXTENDED_COUNT; i++) {
+    uint32_t cp = LAYOUT_EXTENDED[i].codepoint;
+    if (cp < 0x80) {
+      extended += char(cp);
+    } else if (cp < 0x800) {
+      extended += char(0xC0 | (cp >> 6));
+      extended += char(0x80 | (cp & 0x3F));
+    } else {
+      extended += char(0xE0 | (cp >> 12));
+      extended += char(0x80 | ((cp >> 6) & 0x3F));
+      extended += char(0x80 | (cp & 0x3F));
+    }
+  }
+
+  uint32_t checksum = 0;
+  double ascii_ns = ns_per_char(ascii, rounds, checksum);
+  double extended_ns = ns_per_char(extended, rounds, checksum);
+  printf("layout %-7s ascii %6.2f ns/char   extended (%zu entries) %6.2f ns/char   [%08x]\n", LAYOUT_NAME, ascii_ns,
+         LAYOUT_EXTENDED_COUNT, extended_ns, (unsigned) checksum);
+  return 0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Minimal test runner, so the host tests need nothing beyond a compiler.
+// TEST_CASE registers a case; CHECK* record failures and keep going.
+namespace testing {
+
+struct TestCase {
+  const char *name;
+  std::function<void()> run;
+};
+
+inline std::vector<TestCase> &test_cases() {
+  static std::vector<TestCase> cases;
+  return cases;
+}
+
+inline int &failures() {
+  static int count = 0;
+  return count;
+}
+
+struct TestRegistrar {
+  TestRegistrar(const char *name, std::function<void()> run) { test_cases().push_back({name, std::move(run)}); }
+};
+
+inline void report_failure(const char *file, int line, const std::string &what) {
+  failures()++;
+  fprintf(stderr, "%s:%d: FAILED: %s\n", file, line, what.c_str());
+}
+
+template<typename A, typename B> std::string describe(const char *expr, const A &a, const B &b) {
+  return std::string(expr) + " (" + std::to_string(a) + " vs " + std::to_string(b) + ")";
+}
+inline std::string describe(const char *expr, const std::string &a, const std::string &b) {
+  return std::string(expr) + " (\"" + a + "\" vs \"" + b + "\")";
+}
+
+}  // namespace testing
+
+#define TEST_CASE(name) \
+  static void name(); \
+  static ::testing::TestRegistrar name##_registrar(#name, name); \
+  static void name()
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) ::testing::report_failure(__FILE__, __LINE__, #cond); \
+  } while (0)
+
+#define CHECK_OP_(a, op, b) \
+  do { \
+    auto check_a_ = (a); \
+    auto check_b_ = (b); \
+    if (!(check_a_ op check_b_)) \
+      ::testing::report_failure(__FILE__, __LINE__, ::testing::describe(#a " " #op " " #b, check_a_, check_b_)); \
+  } while (0)
+
+#define CHECK_EQ(a, b) CHECK_OP_(a, ==, b)
+#define CHECK_NE(a, b) CHECK_OP_(a, !=, b)
+#define CHECK_LT(a, b) CHECK_OP_(a, <, b)
+#define CHECK_LE(a, b) CHECK_OP_(a, <=, b)
+#define CHECK_GT(a, b) CHECK_OP_(a, >, b)
+#define CHECK_GE(a, b) CHECK_OP_(a, >=, b)
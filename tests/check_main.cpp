@@ -0,0 +1,17 @@
+#include <cstdio>
+#include <cstring>
+#include "check.h"
+
+// Runs every registered case, or those whose name contains argv[1]
+int main(int argc, char **argv) {
+  int run = 0;
+  for (const auto &test : testing::test_cases()) {
+    if (argc > 1 && strstr(test.name, argv[1]) == nullptr) continue;
+    int before = testing::failures();
+    test.run();
+    printf("%s %s\n", testing::failures() == before ? "[  OK  ]" : "[FAILED]", test.name);
+    run++;
+  }
+  printf("%d cases, %d failed checks\n", run, testing::failures());
+  return testing::failures() == 0 && run > 0 ? 0 : 1;
+}
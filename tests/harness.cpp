@@ -0,0 +1,177 @@
+#include "harness.h"
+#include <algorithm>
+
+#include "esp_gatt_defs.h"
+
+namespace testing {
+
+using namespace esphome::espidf_ble_keyboard;
+
+// Report Reference descriptor types
+static const uint8_t REPORT_TYPE_INPUT = 1;
+static const uint8_t REPORT_TYPE_OUTPUT = 2;
+// How long a host may take to get the link encrypted
+static const uint32_t SECURE_TIMEOUT_MS = 3000;
+
+KeyboardHarness::KeyboardHarness(bool reboot) {
+  mock::bt().reset(reboot);
+  mock::reset_runtime();
+  this->kb_.reset(new EspidfBleKeyboard());
+}
+
+KeyboardHarness::~KeyboardHarness() {
+  this->kb_.reset();
+  // Drop the callbacks into the old component, keep bonds and NVS
+  mock::bt().reset(true);
+}
+
+bool KeyboardHarness::start(uint32_t timeout_ms) {
+  this->kb().setup();
+  this->last_loop_ms_ = mock::now_ms();
+  this->kb().loop();
+  return this->run_until([this]() { return this->bt().advertising; }, timeout_ms);
+}
+
+void KeyboardHarness::tick() {
+  mock::advance_ms(1);
+  this->bt().run();
+  mock::run_timeouts();
+  uint32_t now = mock::now_ms();
+  if (esphome::HighFrequencyLoopRequester::is_high_frequency() || now - this->last_loop_ms_ >= LOOP_INTERVAL_MS) {
+    this->last_loop_ms_ = now;
+    this->kb().loop();
+  }
+}
+
+void KeyboardHarness::run_for(uint32_t ms) {
+  for (uint32_t i = 0; i < ms; i++) this->tick();
+}
+
+bool KeyboardHarness::run_until(const std::function<bool()> &done, uint32_t timeout_ms) {
+  for (uint32_t i = 0; i < timeout_ms; i++) {
+    if (done()) return true;
+    this->tick();
+  }
+  return done();
+}
+
+bool KeyboardHarness::run_until_idle(uint32_t timeout_ms) {
+  auto idle = [this]() {
+    return this->kb().queued_reports() == 0 && this->bt().unconfirmed() == 0 && !this->kb().text_pending() &&
+           !this->kb().paste_active();
+  };
+  // Macro steps are only queued by loop(), so idle has to hold across one
+  uint32_t start = mock::now_ms();
+  while (mock::now_ms() - start < timeout_ms) {
+    if (!this->run_until(idle, timeout_ms - (mock::now_ms() - start))) return false;
+    this->run_for(LOOP_INTERVAL_MS);
+    if (idle()) return true;
+  }
+  return false;
+}
+
+mock::Address KeyboardHarness::new_private_address() {
+  static uint32_t count = 0;
+  count++;
+  // Top bits 01 mark a resolvable private address
+  return {0x4C, 0x5A, uint8_t(count >> 16), uint8_t(count >> 8), uint8_t(count), 0x3E};
+}
+
+uint16_t KeyboardHarness::connect(uint8_t id, uint16_t interval, bool subscribe, bool private_address) {
+  mock::Address identity = address(id);
+  uint16_t conn_id = private_address ? this->bt().connect(new_private_address(), interval, &identity)
+                                     : this->bt().connect(identity, interval);
+  // A bonded host encrypts by itself; with a passkey, a new one waits to be
+  // asked
+  bool bonded = this->bt().bonded(identity);
+  if (bonded) this->bt().encrypt(conn_id);
+  if (bonded || this->kb().has_passkey()) {
+    this->run_until(
+        [this, conn_id]() {
+          mock::Link *link = this->bt().link(conn_id);
+          return link != nullptr && link->encrypted;
+        },
+        SECURE_TIMEOUT_MS);
+  }
+  if (subscribe) this->subscribe_all(conn_id);
+  return conn_id;
+}
+
+void KeyboardHarness::subscribe(uint16_t conn_id, uint8_t report_id, bool enabled) {
+  uint16_t ccc = this->ccc_handle(this->input_report_handle(report_id));
+  if (ccc != 0) this->bt().write(conn_id, ccc, {uint8_t(enabled ? 0x01 : 0x00), 0x00});
+}
+
+void KeyboardHarness::subscribe_all(uint16_t conn_id) {
+  for (uint8_t id = REPORT_KEYBOARD; id <= REPORT_MOUSE; id++) this->subscribe(conn_id, id);
+}
+
+void KeyboardHarness::set_leds(uint16_t conn_id, uint8_t leds) {
+  this->bt().write(conn_id, this->output_report_handle(REPORT_KEYBOARD), {leds});
+}
+
+static uint16_t report_handle(const std::vector<mock::Attribute> &attributes, uint8_t report_id, uint8_t type) {
+  uint16_t value = 0;
+  for (const auto &attr : attributes) {
+    if (attr.uuid == ESP_GATT_UUID_HID_REPORT) value = attr.handle;
+    if (attr.uuid == ESP_GATT_UUID_RPT_REF_DESCR && attr.value.size() >= 2 && attr.value[0] == report_id &&
+        attr.value[1] == type)
+      return value;
+  }
+  return 0;
+}
+
+uint16_t KeyboardHarness::input_report_handle(uint8_t report_id) const {
+  return report_handle(mock::bt().attributes, report_id, REPORT_TYPE_INPUT);
+}
+
+uint16_t KeyboardHarness::output_report_handle(uint8_t report_id) const {
+  return report_handle(mock::bt().attributes, report_id, REPORT_TYPE_OUTPUT);
+}
+
+uint16_t KeyboardHarness::ccc_handle(uint16_t value_handle) const {
+  if (value_handle == 0) return 0;
+  for (const auto &attr : mock::bt().attributes) {
+    if (attr.handle <= value_handle) continue;
+    if (attr.uuid == ESP_GATT_UUID_CHAR_DECLARE) break;
+    if (attr.uuid == ESP_GATT_UUID_CHAR_CLIENT_CONFIG) return attr.handle;
+  }
+  return 0;
+}
+
+uint16_t KeyboardHarness::handle_of(uint16_t uuid) const {
+  for (const auto &attr : mock::bt().attributes) {
+    if (attr.uuid == uuid) return attr.handle;
+  }
+  return 0;
+}
+
+std::vector<mock::Notification> KeyboardHarness::reports(uint16_t conn_id, uint8_t report_id) const {
+  return mock::bt().notifications_on(conn_id, this->input_report_handle(report_id));
+}
+
+static char ascii_for(uint8_t modifier, uint8_t keycode) {
+  for (int c = 0; c < 128; c++) {
+    const KeyStroke &key = LAYOUT_KEYMAP.keys[c];
+    if (key.keycode == keycode && key.modifier == modifier) return char(c);
+  }
+  return '?';
+}
+
+std::string KeyboardHarness::typed_text(uint16_t conn_id) const {
+  uint16_t report = this->input_report_handle(REPORT_KEYBOARD);
+  uint16_t boot = this->handle_of(ESP_GATT_UUID_HID_BT_KB_INPUT);
+  std::string text;
+  uint8_t held[6] = {0};
+  for (const auto &n : mock::bt().notifications) {
+    if (n.conn_id != conn_id || (n.handle != report && n.handle != boot) || n.data.size() < 8) continue;
+    for (int i = 2; i < 8; i++) {
+      uint8_t key = n.data[i];
+      if (key != 0 && std::find(held, held + 6, key) == held + 6) text += ascii_for(n.data[0], key);
+    }
+    std::copy(n.data.begin() + 2, n.data.begin() + 8, held);
+  }
+  return text;
+}
+
+}  // namespace testing
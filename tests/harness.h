@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "espidf_ble_keyboard.h"
+#include "mock/bluedroid.h"
+#include "mock/esphome.h"
+
+namespace testing {
+
+using esphome::espidf_ble_keyboard::EspidfBleKeyboard;
+
+// A keyboard on the mock stack, driven one virtual millisecond at a time:
+// stack events are delivered, due timeouts run, and loop() is called every
+// millisecond while the component requests a high frequency loop and every
+// 16 ms otherwise, like ESPHome's main loop.
+class KeyboardHarness {
+ public:
+  static const uint32_t LOOP_INTERVAL_MS = 16;
+  // HID report IDs, see hid_report_map
+  static const uint8_t REPORT_KEYBOARD = 1;
+  static const uint8_t REPORT_CONSUMER = 2;
+  static const uint8_t REPORT_SYSTEM = 3;
+  static const uint8_t REPORT_NKRO = 4;
+  static const uint8_t REPORT_MOUSE = 5;
+
+  // A reboot keeps the mock's bond list and NVS; otherwise both start empty
+  explicit KeyboardHarness(bool reboot = false);
+  ~KeyboardHarness();
+
+  EspidfBleKeyboard &kb() { return *this->kb_; }
+  mock::Bluedroid &bt() { return mock::bt(); }
+
+  // setup() and loop() until advertising; false if it never starts
+  bool start(uint32_t timeout_ms = 2000);
+  void tick();
+  void run_for(uint32_t ms);
+  bool run_until(const std::function<bool()> &done, uint32_t timeout_ms);
+  // Until the queue is empty, every notification is confirmed and no text,
+  // paste or macro is left
+  bool run_until_idle(uint32_t timeout_ms = 60000);
+
+  // Connects a host and enables notifications on every input report. With
+  // a passkey or a bond, waits until the link is encrypted. A host with
+  // a private address connects from a new resolvable private address each
+  // time and is bonded under address(id), its identity.
+  uint16_t connect(uint8_t id, uint16_t interval = 6, bool subscribe = true, bool private_address = false);
+  static mock::Address address(uint8_t id) { return {0x00, 0x1A, 0x7D, 0xDA, 0x71, id}; }
+  static mock::Address new_private_address();
+  void subscribe(uint16_t conn_id, uint8_t report_id, bool enabled = true);
+  void subscribe_all(uint16_t conn_id);
+  void set_leds(uint16_t conn_id, uint8_t leds);
+
+  // Handles found in the attribute table the component registered
+  uint16_t input_report_handle(uint8_t report_id) const;
+  uint16_t output_report_handle(uint8_t report_id) const;
+  uint16_t ccc_handle(uint16_t value_handle) const;
+  uint16_t handle_of(uint16_t uuid) const;
+
+  // Notifications on one report of one host, in send order
+  std::vector<mock::Notification> reports(uint16_t conn_id, uint8_t report_id) const;
+  // Text the host saw typed: keys newly pressed in each keyboard report,
+  // mapped back through the layout's ASCII table ('?' if not in it)
+  std::string typed_text(uint16_t conn_id) const;
+
+ protected:
+  std::unique_ptr<EspidfBleKeyboard> kb_;
+  uint32_t last_loop_ms_{0};
+};
+
+}  // namespace testing
@@ -0,0 +1,511 @@
+#include "bluedroid.h"
+#include <algorithm>
+#include <cstring>
+
+#include "esp_bt.h"
+#include "esp_bt_main.h"
+#include "nvs_flash.h"
+
+namespace mock {
+
+static const uint16_t FIRST_ATTR_HANDLE = 40;
+static const uint16_t SUPERVISION_TIMEOUT = 400;
+// HCI "remote user terminated connection"
+static const int DISCONNECT_REASON = 0x13;
+static const uint8_t AUTH_MODE = ESP_LE_AUTH_BOND | ESP_LE_AUTH_REQ_MITM;
+static const int8_t RSSI = -55;
+
+Bluedroid &Bluedroid::get() {
+  static Bluedroid instance;
+  return instance;
+}
+
+void Bluedroid::reset(bool keep_storage) {
+  auto bonds = std::move(this->bonds);
+  auto nvs = std::move(this->nvs);
+  *this = Bluedroid();
+  if (keep_storage) {
+    this->bonds = std::move(bonds);
+    this->nvs = std::move(nvs);
+  }
+}
+
+void Bluedroid::post(uint32_t delay_ms, std::function<void()> event) {
+  this->events_.push_back({now_ms() + delay_ms, this->event_seq_++, std::move(event)});
+}
+
+void Bluedroid::run() {
+  uint64_t now_us = uint64_t(now_ms()) * 1000;
+  for (;;) {
+    for (size_t i = 0; i < this->links_.size(); i++) {
+      while (i < this->links_.size() && this->links_[i].next_event_us <= now_us) {
+        Link &link = this->links_[i];
+        link.next_event_us += link.interval * 1250;
+        this->connection_event_(link);
+      }
+    }
+    auto next = std::min_element(this->events_.begin(), this->events_.end(), [](const Event &a, const Event &b) {
+      return a.due_ms != b.due_ms ? a.due_ms < b.due_ms : a.seq < b.seq;
+    });
+    if (next == this->events_.end() || next->due_ms > now_ms()) return;
+    std::function<void()> event = std::move(next->run);
+    this->events_.erase(next);
+    event();
+  }
+}
+
+// Up to notifications_per_event queued notifications go out, each confirmed
+// once sent; a congested link recovers when half of its backlog is gone.
+void Bluedroid::connection_event_(Link &link) {
+  uint16_t conn_id = link.conn_id;
+  for (uint8_t i = 0; i < this->notifications_per_event && !link.unconfirmed.empty(); i++) {
+    esp_ble_gatts_cb_param_t param{};
+    param.conf.conn_id = conn_id;
+    param.conf.handle = link.unconfirmed.front();
+    param.conf.status = ESP_GATT_OK;
+    if (this->fail_confirms > 0) {
+      this->fail_confirms--;
+      param.conf.status = ESP_GATT_ERROR;
+    }
+    link.unconfirmed.pop_front();
+    this->gatts_event(ESP_GATTS_CONF_EVT, &param);
+  }
+  Link *still = this->link(conn_id);
+  if (still != nullptr && still->backlog_congested && still->unconfirmed.size() <= this->congest_threshold / 2u) {
+    still->backlog_congested = false;
+    this->set_congested(conn_id, false);
+  }
+}
+
+uint16_t Bluedroid::connect(const Address &bda, uint16_t interval, const Address *identity) {
+  Link link{};
+  link.conn_id = this->next_conn_id_++;
+  link.bda = bda;
+  link.identity = identity != nullptr ? *identity : bda;
+  link.interval = interval;
+  link.next_event_us = uint64_t(now_ms()) * 1000 + interval * 1250;
+  this->links_.push_back(link);
+  // The controller stops advertising once a connection is up
+  this->advertising = false;
+  esp_ble_gatts_cb_param_t param{};
+  param.connect.conn_id = link.conn_id;
+  memcpy(param.connect.remote_bda, bda.data(), ESP_BD_ADDR_LEN);
+  param.connect.conn_params.interval = interval;
+  param.connect.conn_params.timeout = SUPERVISION_TIMEOUT;
+  this->gatts_event(ESP_GATTS_CONNECT_EVT, &param);
+  return link.conn_id;
+}
+
+void Bluedroid::disconnect(uint16_t conn_id) {
+  auto it = std::find_if(this->links_.begin(), this->links_.end(),
+                         [conn_id](const Link &link) { return link.conn_id == conn_id; });
+  if (it == this->links_.end()) return;
+  esp_ble_gatts_cb_param_t param{};
+  param.disconnect.conn_id = conn_id;
+  memcpy(param.disconnect.remote_bda, it->bda.data(), ESP_BD_ADDR_LEN);
+  param.disconnect.reason = DISCONNECT_REASON;
+  this->links_.erase(it);
+  this->gatts_event(ESP_GATTS_DISCONNECT_EVT, &param);
+}
+
+void Bluedroid::write(uint16_t conn_id, uint16_t handle, const std::vector<uint8_t> &value) {
+  for (auto &attr : this->attributes) {
+    if (attr.handle == handle) attr.value = value;
+  }
+  std::vector<uint8_t> copy = value;
+  esp_ble_gatts_cb_param_t param{};
+  param.write.conn_id = conn_id;
+  param.write.handle = handle;
+  param.write.len = copy.size();
+  param.write.value = copy.data();
+  Link *link = this->link(conn_id);
+  if (link != nullptr) memcpy(param.write.bda, link->bda.data(), ESP_BD_ADDR_LEN);
+  this->gatts_event(ESP_GATTS_WRITE_EVT, &param);
+}
+
+void Bluedroid::set_mtu(uint16_t conn_id, uint16_t mtu) {
+  esp_ble_gatts_cb_param_t param{};
+  param.mtu.conn_id = conn_id;
+  param.mtu.mtu = mtu;
+  this->gatts_event(ESP_GATTS_MTU_EVT, &param);
+}
+
+void Bluedroid::encrypt(uint16_t conn_id) {
+  Link *link = this->link(conn_id);
+  if (link == nullptr) return;
+  uint32_t delay = this->bonded(link->identity) ? this->encrypt_ms : this->pairing_ms;
+  this->post(delay, [this, conn_id]() { this->auth_complete_(conn_id); });
+}
+
+void Bluedroid::set_congested(uint16_t conn_id, bool congested) {
+  Link *link = this->link(conn_id);
+  if (link == nullptr) return;
+  link->congested = congested;
+  esp_ble_gatts_cb_param_t param{};
+  param.congest.conn_id = conn_id;
+  param.congest.congested = congested;
+  this->gatts_event(ESP_GATTS_CONGEST_EVT, &param);
+}
+
+Link *Bluedroid::link(uint16_t conn_id) {
+  for (auto &link : this->links_) {
+    if (link.conn_id == conn_id) return &link;
+  }
+  return nullptr;
+}
+
+Link *Bluedroid::link(const uint8_t *bda) {
+  for (auto &link : this->links_) {
+    if (memcmp(link.bda.data(), bda, ESP_BD_ADDR_LEN) == 0) return &link;
+  }
+  return nullptr;
+}
+
+bool Bluedroid::bonded(const Address &identity) const {
+  return std::any_of(this->bonds.begin(), this->bonds.end(), [&identity](const esp_ble_bond_dev_t &bond) {
+    return memcmp(bond.bd_addr, identity.data(), ESP_BD_ADDR_LEN) == 0;
+  });
+}
+
+size_t Bluedroid::unconfirmed() const {
+  size_t count = 0;
+  for (const auto &link : this->links_) count += link.unconfirmed.size();
+  return count;
+}
+
+std::vector<Notification> Bluedroid::notifications_on(uint16_t conn_id, uint16_t handle) const {
+  std::vector<Notification> result;
+  for (const auto &n : this->notifications) {
+    if (n.conn_id == conn_id && n.handle == handle) result.push_back(n);
+  }
+  return result;
+}
+
+void Bluedroid::gatts_event(esp_gatts_cb_event_t event, esp_ble_gatts_cb_param_t *param) {
+  if (this->gatts_cb_ != nullptr) this->gatts_cb_(event, this->gatts_if_, param);
+}
+
+void Bluedroid::gap_event(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param) {
+  if (this->gap_cb_ != nullptr) this->gap_cb_(event, param);
+}
+
+esp_err_t Bluedroid::create_attr_tab(const esp_gatts_attr_db_t *db, uint16_t count) {
+  this->attributes.clear();
+  this->table_handles_.clear();
+  for (uint16_t i = 0; i < count; i++) {
+    const esp_attr_desc_t &desc = db[i].att_desc;
+    Attribute attr{};
+    attr.handle = FIRST_ATTR_HANDLE + i;
+    if (desc.uuid_length == ESP_UUID_LEN_16) attr.uuid = desc.uuid_p[0] | (desc.uuid_p[1] << 8);
+    if (desc.value != nullptr) attr.value.assign(desc.value, desc.value + desc.length);
+    this->attributes.push_back(attr);
+    this->table_handles_.push_back(attr.handle);
+  }
+  this->post(0, [this, count]() {
+    esp_ble_gatts_cb_param_t param{};
+    param.add_attr_tab.status = ESP_GATT_OK;
+    param.add_attr_tab.num_handle = count;
+    param.add_attr_tab.handles = this->table_handles_.data();
+    this->gatts_event(ESP_GATTS_CREAT_ATTR_TAB_EVT, &param);
+  });
+  return ESP_OK;
+}
+
+esp_err_t Bluedroid::send(uint16_t conn_id, uint16_t handle, uint16_t len, const uint8_t *value) {
+  this->send_calls++;
+  if (this->fail_sends > 0) {
+    this->fail_sends--;
+    return ESP_FAIL;
+  }
+  Link *link = this->link(conn_id);
+  if (link == nullptr) return ESP_FAIL;
+  this->notifications.push_back({now_ms(), conn_id, handle, std::vector<uint8_t>(value, value + len)});
+  link->unconfirmed.push_back(handle);
+  if (!link->congested && !link->backlog_congested && link->unconfirmed.size() >= this->congest_threshold) {
+    link->backlog_congested = true;
+    this->post(0, [this, conn_id]() { this->set_congested(conn_id, true); });
+  }
+  return ESP_OK;
+}
+
+esp_err_t Bluedroid::set_encryption(const uint8_t *bda) {
+  Link *link = this->link(bda);
+  if (link == nullptr) return ESP_ERR_INVALID_ARG;
+  Address addr;
+  memcpy(addr.data(), bda, ESP_BD_ADDR_LEN);
+  this->encryption_requests.push_back(addr);
+  this->encrypt(link->conn_id);
+  return ESP_OK;
+}
+
+// Pairing bonds the host under its identity address, which is what the
+// event reports from then on
+void Bluedroid::auth_complete_(uint16_t conn_id) {
+  Link *link = this->link(conn_id);
+  if (link == nullptr) return;
+  link->encrypted = true;
+  bool random = (link->identity[0] & 0xC0) == 0xC0;
+  if (!this->bonded(link->identity)) {
+    esp_ble_bond_dev_t bond{};
+    memcpy(bond.bd_addr, link->identity.data(), ESP_BD_ADDR_LEN);
+    bond.bd_addr_type = random ? BLE_ADDR_TYPE_RANDOM : BLE_ADDR_TYPE_PUBLIC;
+    this->bonds.push_back(bond);
+  }
+  esp_ble_gap_cb_param_t param{};
+  esp_ble_auth_cmpl_t &auth = param.ble_security.auth_cmpl;
+  memcpy(auth.bd_addr, link->identity.data(), ESP_BD_ADDR_LEN);
+  auth.key_present = true;
+  auth.success = true;
+  auth.addr_type = random ? BLE_ADDR_TYPE_RANDOM : BLE_ADDR_TYPE_PUBLIC;
+  auth.auth_mode = AUTH_MODE;
+  this->gap_event(ESP_GAP_BLE_AUTH_CMPL_EVT, &param);
+}
+
+// The central accepts the request and switches after two connection events
+esp_err_t Bluedroid::update_conn_params(const esp_ble_conn_update_params_t &params) {
+  Link *link = this->link(params.bda);
+  if (link == nullptr) return ESP_ERR_INVALID_ARG;
+  this->conn_param_requests.push_back(params);
+  uint16_t conn_id = link->conn_id;
+  this->post(link->interval * 5 / 2, [this, conn_id, params]() {
+    Link *link = this->link(conn_id);
+    if (link == nullptr) return;
+    link->interval = params.max_int;
+    esp_ble_gap_cb_param_t param{};
+    param.update_conn_params.status = ESP_BT_STATUS_SUCCESS;
+    memcpy(param.update_conn_params.bda, link->bda.data(), ESP_BD_ADDR_LEN);
+    param.update_conn_params.min_int = params.min_int;
+    param.update_conn_params.max_int = params.max_int;
+    param.update_conn_params.latency = params.latency;
+    param.update_conn_params.conn_int = params.max_int;
+    param.update_conn_params.timeout = params.timeout;
+    this->gap_event(ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT, &param);
+  });
+  return ESP_OK;
+}
+
+esp_err_t Bluedroid::nvs_open(const char *name, bool create, nvs_handle_t *handle) {
+  std::string prefix = std::string(name) + "/";
+  bool exists = std::any_of(this->nvs.begin(), this->nvs.end(), [&prefix](const auto &entry) {
+    return entry.first.compare(0, prefix.size(), prefix) == 0;
+  });
+  if (!exists && !create) return ESP_ERR_NVS_NOT_FOUND;
+  this->nvs_namespaces_.push_back(name);
+  *handle = this->nvs_namespaces_.size();
+  return ESP_OK;
+}
+
+std::string Bluedroid::nvs_key(nvs_handle_t handle, const char *key) const {
+  if (handle == 0 || handle > this->nvs_namespaces_.size()) return "";
+  return this->nvs_namespaces_[handle - 1] + "/" + key;
+}
+
+}  // namespace mock
+
+using mock::bt;
+
+// ── ESP-IDF API ──────────────────────────────────────────────────────────────
+
+const char *esp_err_to_name(esp_err_t code) {
+  switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    default: return "UNKNOWN ERROR";
+  }
+}
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode) { return ESP_OK; }
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t *cfg) { return ESP_OK; }
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode) { return ESP_OK; }
+esp_err_t esp_ble_tx_power_set(esp_ble_power_type_t power_type, esp_power_level_t power_level) { return ESP_OK; }
+esp_err_t esp_bluedroid_init(void) { return ESP_OK; }
+esp_err_t esp_bluedroid_enable(void) { return ESP_OK; }
+
+esp_err_t esp_ble_gatts_register_callback(esp_gatts_cb_t callback) {
+  bt().on_register_gatts(callback);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_app_register(uint16_t app_id) {
+  bt().post(0, [app_id]() {
+    esp_ble_gatts_cb_param_t param{};
+    param.reg.status = ESP_GATT_OK;
+    param.reg.app_id = app_id;
+    bt().gatts_event(ESP_GATTS_REG_EVT, &param);
+  });
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_create_attr_tab(const esp_gatts_attr_db_t *gatts_attr_db, esp_gatt_if_t gatts_if,
+                                        uint16_t max_nb_attr, uint8_t srvc_inst_id) {
+  if (gatts_if != bt().gatts_if()) return ESP_ERR_INVALID_ARG;
+  return bt().create_attr_tab(gatts_attr_db, max_nb_attr);
+}
+
+esp_err_t esp_ble_gatts_start_service(uint16_t service_handle) {
+  bt().post(0, [service_handle]() {
+    esp_ble_gatts_cb_param_t param{};
+    param.start.status = ESP_GATT_OK;
+    param.start.service_handle = service_handle;
+    bt().gatts_event(ESP_GATTS_START_EVT, &param);
+  });
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gatts_send_indicate(esp_gatt_if_t gatts_if, uint16_t conn_id, uint16_t attr_handle,
+                                      uint16_t value_len, uint8_t *value, bool need_confirm) {
+  if (gatts_if != bt().gatts_if()) return ESP_ERR_INVALID_ARG;
+  return bt().send(conn_id, attr_handle, value_len, value);
+}
+
+esp_err_t esp_ble_gap_register_callback(esp_gap_ble_cb_t callback) {
+  bt().on_register_gap(callback);
+  return ESP_OK;
+}
+
+static void post_gap_status(esp_gap_ble_cb_event_t event, uint32_t delay_ms = 0) {
+  bt().post(delay_ms, [event]() {
+    esp_ble_gap_cb_param_t param{};
+    param.adv_start_cmpl.status = ESP_BT_STATUS_SUCCESS;  // same layout for every *_cmpl status
+    bt().gap_event(event, &param);
+  });
+}
+
+esp_err_t esp_ble_gap_config_adv_data_raw(uint8_t *raw_data, uint32_t raw_data_len) {
+  if (raw_data_len > 31) return ESP_ERR_INVALID_ARG;
+  post_gap_status(ESP_GAP_BLE_ADV_DATA_RAW_SET_COMPLETE_EVT);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_config_scan_rsp_data_raw(uint8_t *raw_data, uint32_t raw_data_len) {
+  if (raw_data_len > 31) return ESP_ERR_INVALID_ARG;
+  post_gap_status(ESP_GAP_BLE_SCAN_RSP_DATA_RAW_SET_COMPLETE_EVT);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_start_advertising(esp_ble_adv_params_t *adv_params) {
+  if (adv_params == nullptr) return ESP_ERR_INVALID_ARG;
+  bt().adv_starts.push_back(*adv_params);
+  bt().advertising = true;
+  post_gap_status(ESP_GAP_BLE_ADV_START_COMPLETE_EVT, 1);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_stop_advertising(void) {
+  bt().advertising = false;
+  post_gap_status(ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT);
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_set_device_name(const char *name) {
+  bt().device_name = name;
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_update_conn_params(esp_ble_conn_update_params_t *params) {
+  return bt().update_conn_params(*params);
+}
+
+esp_err_t esp_ble_gap_read_rssi(esp_bd_addr_t remote_addr) {
+  mock::Address addr;
+  memcpy(addr.data(), remote_addr, ESP_BD_ADDR_LEN);
+  bt().post(5, [addr]() {
+    esp_ble_gap_cb_param_t param{};
+    param.read_rssi_cmpl.status = ESP_BT_STATUS_SUCCESS;
+    param.read_rssi_cmpl.rssi = mock::RSSI;
+    memcpy(param.read_rssi_cmpl.remote_addr, addr.data(), ESP_BD_ADDR_LEN);
+    bt().gap_event(ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT, &param);
+  });
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_disconnect(esp_bd_addr_t remote_device) {
+  mock::Link *link = bt().link(remote_device);
+  if (link == nullptr) return ESP_ERR_INVALID_ARG;
+  uint16_t conn_id = link->conn_id;
+  bt().post(0, [conn_id]() { bt().disconnect(conn_id); });
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_security_rsp(esp_bd_addr_t bd_addr, bool accept) { return ESP_OK; }
+esp_err_t esp_ble_gap_set_security_param(esp_ble_sm_param_t param_type, void *value, uint8_t len) {
+  return value != nullptr && len > 0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_ble_set_encryption(esp_bd_addr_t bd_addr, esp_ble_sec_act_t sec_act) {
+  return bt().set_encryption(bd_addr);
+}
+
+esp_err_t esp_ble_gap_clear_whitelist(void) {
+  bt().whitelist.clear();
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_gap_update_whitelist(bool add_remove, esp_bd_addr_t remote_bda, esp_ble_wl_addr_type_t wl_addr_type) {
+  mock::Address addr;
+  memcpy(addr.data(), remote_bda, ESP_BD_ADDR_LEN);
+  auto &list = bt().whitelist;
+  list.erase(std::remove(list.begin(), list.end(), addr), list.end());
+  if (add_remove) list.push_back(addr);
+  return ESP_OK;
+}
+
+int esp_ble_get_bond_device_num(void) { return bt().bonds.size(); }
+
+esp_err_t esp_ble_get_bond_device_list(int *dev_num, esp_ble_bond_dev_t *dev_list) {
+  if (dev_num == nullptr || dev_list == nullptr) return ESP_ERR_INVALID_ARG;
+  int count = std::min<int>(*dev_num, bt().bonds.size());
+  std::copy(bt().bonds.begin(), bt().bonds.begin() + count, dev_list);
+  *dev_num = count;
+  return ESP_OK;
+}
+
+esp_err_t esp_ble_remove_bond_device(esp_bd_addr_t bd_addr) {
+  auto &bonds = bt().bonds;
+  auto it = std::find_if(bonds.begin(), bonds.end(), [bd_addr](const esp_ble_bond_dev_t &bond) {
+    return memcmp(bond.bd_addr, bd_addr, ESP_BD_ADDR_LEN) == 0;
+  });
+  if (it == bonds.end()) return ESP_FAIL;
+  bonds.erase(it);
+  return ESP_OK;
+}
+
+// ── NVS ──────────────────────────────────────────────────────────────────────
+
+esp_err_t nvs_flash_init(void) { return ESP_OK; }
+
+esp_err_t nvs_flash_erase(void) {
+  bt().nvs.clear();
+  return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+  return bt().nvs_open(namespace_name, open_mode == NVS_READWRITE, out_handle);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+  auto it = bt().nvs.find(bt().nvs_key(handle, key));
+  if (it == bt().nvs.end()) return ESP_ERR_NVS_NOT_FOUND;
+  if (out_value != nullptr) {
+    if (*length < it->second.size()) return ESP_ERR_NVS_INVALID_LENGTH;
+    memcpy(out_value, it->second.data(), it->second.size());
+  }
+  *length = it->second.size();
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+  std::string name = bt().nvs_key(handle, key);
+  if (name.empty()) return ESP_ERR_INVALID_ARG;
+  const uint8_t *bytes = static_cast<const uint8_t *>(value);
+  bt().nvs[name].assign(bytes, bytes + length);
+  return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) { return ESP_OK; }
+void nvs_close(nvs_handle_t handle) {}
@@ -0,0 +1,152 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "esp_gap_ble_api.h"
+#include "esp_gatts_api.h"
+#include "nvs.h"
+
+// ── Mock Bluedroid ───────────────────────────────────────────────────────────
+// Implements the GATTS/GAP/NVS calls the component makes and plays the BT
+// task: whatever the real stack reports through a callback later (REG_EVT,
+// CREAT_ATTR_TAB_EVT, CONF_EVT, ...) is posted here and delivered by run(),
+// which the harness calls between two loop()s. The central's side (connect,
+// CCC writes, encryption) is injected with the methods below and delivered
+// right away. Every notification is recorded with its virtual timestamp.
+namespace mock {
+
+using Address = std::array<uint8_t, ESP_BD_ADDR_LEN>;
+
+// Virtual clock shared by millis(), the scheduler and the link model
+uint32_t now_ms();
+void advance_ms(uint32_t ms);
+// Time spent in vTaskDelay() so far, i.e. how long callers were blocked
+uint32_t blocked_ms();
+
+struct Notification {
+  uint32_t ms;
+  uint16_t conn_id;
+  uint16_t handle;
+  std::vector<uint8_t> data;
+};
+
+// One entry of the attribute table the component created
+struct Attribute {
+  uint16_t handle;
+  uint16_t uuid;
+  std::vector<uint8_t> value;
+};
+
+// A connection as the controller sees it. Notifications are sent at the next
+// connection events, notifications_per_event at a time, and confirmed with
+// ESP_GATTS_CONF_EVT when they went out.
+struct Link {
+  uint16_t conn_id;
+  Address bda;
+  Address identity;  // what AUTH_CMPL_EVT reports
+  uint16_t interval;  // 1.25 ms units
+  uint64_t next_event_us;
+  std::deque<uint16_t> unconfirmed;  // handles
+  bool congested{false};
+  bool backlog_congested{false};  // raised by the mock, cleared once the backlog drains
+  bool encrypted{false};
+};
+
+class Bluedroid {
+ public:
+  static Bluedroid &get();
+  // Forgets everything but, with keep_storage, the bond list and NVS (a reboot)
+  void reset(bool keep_storage = false);
+
+  // Link model
+  uint8_t notifications_per_event{4};
+  // Unconfirmed notifications on a link before it reports congestion
+  uint8_t congest_threshold{12};
+  // How long pairing (passkey entry included) takes once encryption is requested
+  uint32_t pairing_ms{150};
+  // How long encrypting with stored keys takes
+  uint32_t encrypt_ms{30};
+  // The next fail_sends esp_ble_gatts_send_indicate() calls return ESP_FAIL
+  int fail_sends{0};
+  // The next fail_confirms notifications are confirmed with an error status
+  int fail_confirms{0};
+
+  // What the component did
+  std::vector<Notification> notifications;
+  std::vector<Attribute> attributes;
+  std::vector<esp_ble_conn_update_params_t> conn_param_requests;
+  std::vector<esp_ble_adv_params_t> adv_starts;
+  std::vector<Address> encryption_requests;
+  std::vector<Address> whitelist;
+  std::string device_name;
+  bool advertising{false};
+  uint32_t send_calls{0};
+
+  // Persistent storage
+  std::vector<esp_ble_bond_dev_t> bonds;
+  std::map<std::string, std::vector<uint8_t>> nvs;
+
+  // Delivers due stack events and runs connection events up to now_ms()
+  void run();
+  void post(uint32_t delay_ms, std::function<void()> event);
+  bool registered() const { return gatts_cb_ != nullptr && gap_cb_ != nullptr; }
+
+  // Central side
+  uint16_t connect(const Address &bda, uint16_t interval = 6, const Address *identity = nullptr);
+  void disconnect(uint16_t conn_id);
+  void write(uint16_t conn_id, uint16_t handle, const std::vector<uint8_t> &value);
+  void set_mtu(uint16_t conn_id, uint16_t mtu);
+  // The host encrypts with the keys from an earlier pairing
+  void encrypt(uint16_t conn_id);
+  // Reports congestion until called again with false
+  void set_congested(uint16_t conn_id, bool congested);
+  Link *link(uint16_t conn_id);
+  Link *link(const uint8_t *bda);
+  bool bonded(const Address &identity) const;
+  // Notifications sent on any link that are not confirmed yet
+  size_t unconfirmed() const;
+  std::vector<Notification> notifications_on(uint16_t conn_id, uint16_t handle) const;
+
+  // Raw event injection, delivered right away
+  void gatts_event(esp_gatts_cb_event_t event, esp_ble_gatts_cb_param_t *param);
+  void gap_event(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
+
+  // Called by the API stand-ins
+  void on_register_gatts(esp_gatts_cb_t cb) { gatts_cb_ = cb; }
+  void on_register_gap(esp_gap_ble_cb_t cb) { gap_cb_ = cb; }
+  esp_gatt_if_t gatts_if() const { return gatts_if_; }
+  esp_err_t create_attr_tab(const esp_gatts_attr_db_t *db, uint16_t count);
+  esp_err_t send(uint16_t conn_id, uint16_t handle, uint16_t len, const uint8_t *value);
+  esp_err_t set_encryption(const uint8_t *bda);
+  esp_err_t update_conn_params(const esp_ble_conn_update_params_t &params);
+  esp_err_t nvs_open(const char *name, bool create, nvs_handle_t *handle);
+  std::string nvs_key(nvs_handle_t handle, const char *key) const;
+
+ protected:
+  struct Event {
+    uint32_t due_ms;
+    uint64_t seq;
+    std::function<void()> run;
+  };
+  void connection_event_(Link &link);
+  void auth_complete_(uint16_t conn_id);
+
+  esp_gatts_cb_t gatts_cb_{nullptr};
+  esp_gap_ble_cb_t gap_cb_{nullptr};
+  esp_gatt_if_t gatts_if_{3};
+  std::vector<uint16_t> table_handles_;
+  std::vector<std::string> nvs_namespaces_;
+  std::deque<Link> links_;
+  std::vector<Event> events_;
+  uint64_t event_seq_{0};
+  uint16_t next_conn_id_{0};
+};
+
+inline Bluedroid &bt() { return Bluedroid::get(); }
+
+}  // namespace mock
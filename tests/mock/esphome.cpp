@@ -0,0 +1,132 @@
+#include "esphome.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "bluedroid.h"
+#include "esphome/core/component.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
+#include "freertos/task.h"
+
+namespace mock {
+
+// millis() starts past zero, as it would after boot
+static const uint32_t BOOT_MS = 1000;
+
+static uint32_t s_now_ms = BOOT_MS;
+static uint32_t s_blocked_ms = 0;
+static uint32_t s_log_counts[ESPHOME_LOG_LEVEL_DEBUG + 1] = {0};
+
+struct Timeout {
+  esphome::Component *component;
+  std::string name;  // empty: anonymous
+  uint32_t due_ms;
+  uint64_t seq;
+  std::function<void()> f;
+};
+static std::vector<Timeout> s_timeouts;
+static uint64_t s_timeout_seq = 0;
+
+uint32_t now_ms() { return s_now_ms; }
+void advance_ms(uint32_t ms) { s_now_ms += ms; }
+uint32_t blocked_ms() { return s_blocked_ms; }
+
+void reset_runtime() {
+  s_now_ms = BOOT_MS;
+  s_blocked_ms = 0;
+  std::fill(std::begin(s_log_counts), std::end(s_log_counts), 0);
+  s_timeouts.clear();
+}
+
+void run_timeouts() {
+  // Only what is due now; timeouts set from a callback wait for the next pass
+  std::vector<Timeout> due;
+  for (auto it = s_timeouts.begin(); it != s_timeouts.end();) {
+    if (int32_t(s_now_ms - it->due_ms) >= 0) {
+      due.push_back(std::move(*it));
+      it = s_timeouts.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  std::sort(due.begin(), due.end(), [](const Timeout &a, const Timeout &b) {
+    return a.due_ms != b.due_ms ? int32_t(a.due_ms - b.due_ms) < 0 : a.seq < b.seq;
+  });
+  for (auto &timeout : due) timeout.f();
+}
+
+size_t pending_timeouts() { return s_timeouts.size(); }
+
+uint32_t log_count(int level) { return level >= 0 && level <= ESPHOME_LOG_LEVEL_DEBUG ? s_log_counts[level] : 0; }
+
+static void cancel(esphome::Component *component, const std::string &name) {
+  s_timeouts.erase(std::remove_if(s_timeouts.begin(), s_timeouts.end(),
+                                  [&](const Timeout &t) {
+                                    return t.component == component && (name.empty() || t.name == name);
+                                  }),
+                   s_timeouts.end());
+}
+
+}  // namespace mock
+
+namespace esphome {
+
+uint32_t millis() { return mock::s_now_ms; }
+uint32_t micros() { return mock::s_now_ms * 1000; }
+void delay(uint32_t ms) {
+  mock::s_blocked_ms += ms;
+  mock::s_now_ms += ms;
+}
+
+Component::~Component() { mock::cancel(this, ""); }
+
+void Component::set_timeout(const std::string &name, uint32_t timeout, std::function<void()> &&f) {
+  if (!name.empty()) mock::cancel(this, name);
+  mock::s_timeouts.push_back({this, name, mock::s_now_ms + timeout, mock::s_timeout_seq++, std::move(f)});
+}
+
+void Component::set_timeout(uint32_t timeout, std::function<void()> &&f) { this->set_timeout("", timeout, std::move(f)); }
+
+bool Component::cancel_timeout(const std::string &name) {
+  size_t before = mock::s_timeouts.size();
+  mock::cancel(this, name);
+  return mock::s_timeouts.size() != before;
+}
+
+uint32_t HighFrequencyLoopRequester::num_requests = 0;
+
+void HighFrequencyLoopRequester::start() {
+  if (this->started_) return;
+  this->started_ = true;
+  num_requests++;
+}
+
+void HighFrequencyLoopRequester::stop() {
+  if (!this->started_) return;
+  this->started_ = false;
+  num_requests--;
+}
+
+bool HighFrequencyLoopRequester::is_high_frequency() { return num_requests > 0; }
+
+void esp_log_printf_(int level, const char *tag, int line, const char *format, ...) {
+  if (level >= 0 && level <= ESPHOME_LOG_LEVEL_DEBUG) mock::s_log_counts[level]++;
+  static const int max_level = getenv("KEYBOARD_TEST_LOG") ? atoi(getenv("KEYBOARD_TEST_LOG")) : ESPHOME_LOG_LEVEL_ERROR;
+  if (level > max_level) return;
+  static const char LEVELS[] = "-EWICD";
+  fprintf(stderr, "[%7u][%c][%s:%d]: ", (unsigned) mock::s_now_ms, LEVELS[level], tag, line);
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+}  // namespace esphome
+
+void vTaskDelay(const TickType_t ticks) { esphome::delay(ticks * portTICK_PERIOD_MS); }
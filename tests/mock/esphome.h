@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// ── Mock ESPHome runtime ─────────────────────────────────────────────────────
+// Virtual clock, Component timeouts and the logger for the host build.
+namespace mock {
+
+// Clock back to its boot value, timeouts, log counters and blocked time cleared
+void reset_runtime();
+// Runs the timeouts that are due, like the scheduler ahead of each loop()
+void run_timeouts();
+size_t pending_timeouts();
+// Messages logged at this level so far (ESPHOME_LOG_LEVEL_*)
+uint32_t log_count(int level);
+
+}  // namespace mock
@@ -0,0 +1,40 @@
+#pragma once
+// Host stand-in for ESP-IDF's esp_bt.h (controller).
+#include "esp_err.h"
+#include "esp_bt_defs.h"
+
+typedef enum {
+  ESP_BT_MODE_IDLE = 0x00,
+  ESP_BT_MODE_BLE = 0x01,
+  ESP_BT_MODE_CLASSIC_BT = 0x02,
+  ESP_BT_MODE_BTDM = 0x03,
+} esp_bt_mode_t;
+
+typedef struct {
+  uint16_t controller_task_stack_size;
+} esp_bt_controller_config_t;
+
+#define BT_CONTROLLER_INIT_CONFIG_DEFAULT() {4096}
+
+typedef enum {
+  ESP_PWR_LVL_N12 = 0,
+  ESP_PWR_LVL_N9,
+  ESP_PWR_LVL_N6,
+  ESP_PWR_LVL_N3,
+  ESP_PWR_LVL_N0,
+  ESP_PWR_LVL_P3,
+  ESP_PWR_LVL_P6,
+  ESP_PWR_LVL_P9,
+} esp_power_level_t;
+
+typedef enum {
+  ESP_BLE_PWR_TYPE_CONN_HDL0 = 0,
+  ESP_BLE_PWR_TYPE_ADV = 9,
+  ESP_BLE_PWR_TYPE_SCAN = 10,
+  ESP_BLE_PWR_TYPE_DEFAULT = 11,
+} esp_ble_power_type_t;
+
+esp_err_t esp_bt_controller_mem_release(esp_bt_mode_t mode);
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t *cfg);
+esp_err_t esp_bt_controller_enable(esp_bt_mode_t mode);
+esp_err_t esp_ble_tx_power_set(esp_ble_power_type_t power_type, esp_power_level_t power_level);
@@ -0,0 +1,6 @@
+#pragma once
+// Host stand-in for ESP-IDF's esp_bt_main.h (Bluedroid host stack).
+#include "esp_err.h"
+
+esp_err_t esp_bluedroid_init(void);
+esp_err_t esp_bluedroid_enable(void);
@@ -0,0 +1,62 @@
+#pragma once
+#include <functional>
+#include <utility>
+#include "esphome/core/component.h"
+#include "esphome/core/helpers.h"
+
+namespace esphome {
+
+template<typename T, typename... X> class TemplatableValue {
+ public:
+  TemplatableValue() = default;
+  template<typename V, typename std::enable_if<std::is_convertible<V, T>::value, int>::type = 0>
+  TemplatableValue(V value) : has_value_(true), value_(value) {}
+  template<typename F, typename std::enable_if<!std::is_convertible<F, T>::value, int>::type = 0>
+  TemplatableValue(F f) : has_value_(true), f_(f) {}
+
+  bool has_value() const { return has_value_; }
+  T value(X... x) const { return f_ ? f_(x...) : value_; }
+
+ protected:
+  bool has_value_{false};
+  T value_{};
+  std::function<T(X...)> f_;
+};
+
+#define TEMPLATABLE_VALUE_(type, name) \
+ protected: \
+  TemplatableValue<type, Ts...> name##_{}; \
+\
+ public: \
+  template<typename V> void set_##name(V name) { this->name##_ = name; }
+
+#define TEMPLATABLE_VALUE(type, name) TEMPLATABLE_VALUE_(type, name)
+
+template<typename... Ts> class Trigger {
+ public:
+  void trigger(Ts... x) {}
+};
+
+// Single actions only: play_next_() marks the action finished instead of
+// starting a following one.
+template<typename... Ts> class Action {
+ public:
+  virtual ~Action() = default;
+  virtual void play_complex(Ts... x) {
+    this->num_running_++;
+    this->play(x...);
+    this->play_next_(x...);
+  }
+  virtual void stop() {}
+  bool is_running() const { return this->num_running_ > 0; }
+
+ protected:
+  virtual void play(Ts... x) = 0;
+  void play_next_(Ts... x) {
+    if (this->num_running_ > 0) this->num_running_--;
+  }
+
+  int num_running_{0};
+};
+
+}  // namespace esphome
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "esphome/core/defines.h"
+
+namespace esphome {
+
+namespace setup_priority {
+static const float BLUETOOTH = 350.0f;
+static const float DATA = 600.0f;
+}  // namespace setup_priority
+
+// Host stand-in for ESPHome's Component. Timeouts run on the harness's
+// virtual clock (tests/mock/esphome.cpp).
+class Component {
+ public:
+  virtual ~Component();
+  virtual void setup() {}
+  virtual void loop() {}
+  virtual void dump_config() {}
+  virtual float get_setup_priority() const { return setup_priority::DATA; }
+  void set_setup_priority(float priority) {}
+
+  void mark_failed() { failed_ = true; }
+  bool is_failed() const { return failed_; }
+
+ protected:
+  // A named timeout replaces a pending one of the same name
+  void set_timeout(const std::string &name, uint32_t timeout, std::function<void()> &&f);
+  void set_timeout(uint32_t timeout, std::function<void()> &&f);
+  bool cancel_timeout(const std::string &name);
+
+  bool failed_{false};
+};
+
+}  // namespace esphome
@@ -0,0 +1,5 @@
+#pragma once
+// Normally generated by codegen; the host build enables every optional
+// platform the component supports.
+#define USE_SENSOR
+#define USE_BINARY_SENSOR
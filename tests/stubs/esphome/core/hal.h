@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdint>
+
+namespace esphome {
+
+// Virtual time of the host harness (tests/mock/esphome.cpp)
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+
+}  // namespace esphome
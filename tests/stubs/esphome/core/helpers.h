@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+
+namespace esphome {
+
+// While any requester is started, the harness runs loop() every millisecond
+// instead of every 16 ms, like ESPHome's main loop does.
+class HighFrequencyLoopRequester {
+ public:
+  ~HighFrequencyLoopRequester() { this->stop(); }
+  void start();
+  void stop();
+  static bool is_high_frequency();
+
+ protected:
+  bool started_{false};
+  static uint32_t num_requests;
+};
+
+template<typename T> class Parented {
+ public:
+  Parented() {}
+  Parented(T *parent) : parent_(parent) {}
+  T *get_parent() const { return parent_; }
+  void set_parent(T *parent) { parent_ = parent; }
+
+ protected:
+  T *parent_{nullptr};
+};
+
+}  // namespace esphome
+
+#define YESNO(b) ((b) ? "YES" : "NO")
+#define ONOFF(b) ((b) ? "ON" : "OFF")
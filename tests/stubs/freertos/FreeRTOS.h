@@ -0,0 +1,7 @@
+#pragma once
+// Host stand-in for FreeRTOS: one tick per millisecond.
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+#define portTICK_PERIOD_MS ((TickType_t) 1)
+#define pdMS_TO_TICKS(ms) ((TickType_t) (ms))
@@ -0,0 +1,6 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+// Advances the virtual clock, so time a caller spends blocked shows up in
+// the harness (see mock::blocked_ms()).
+void vTaskDelay(const TickType_t ticks);
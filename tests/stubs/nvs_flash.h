@@ -0,0 +1,6 @@
+#pragma once
+// Host stand-in for ESP-IDF's nvs_flash.h.
+#include "esp_err.h"
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
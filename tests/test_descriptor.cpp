@@ -0,0 +1,147 @@
+// The HID report map and attribute table the component registers, for the
+// `reports:` combination this binary is built with (see CMakeLists.txt).
+#include <map>
+
+#include "check.h"
+#include "esp_gatt_defs.h"
+#include "harness.h"
+
+using testing::KeyboardHarness;
+using namespace esphome::espidf_ble_keyboard;
+
+// Input and output report sizes in bits, per Report ID
+struct ReportSizes {
+  std::map<uint8_t, uint32_t> input;
+  std::map<uint8_t, uint32_t> output;
+  bool valid;
+};
+
+// Walks the short items like a host parser would; valid if every item fits
+// and collections nest and close
+static ReportSizes parse_report_map(const std::vector<uint8_t> &map) {
+  ReportSizes sizes{{}, {}, false};
+  uint32_t report_size = 0, report_count = 0;
+  uint8_t report_id = 0;
+  int depth = 0;
+  size_t i = 0;
+  while (i < map.size()) {
+    uint8_t prefix = map[i];
+    size_t size = (prefix & 0x03) == 3 ? 4 : (prefix & 0x03);
+    if (prefix == 0xFE || i + 1 + size > map.size()) return sizes;
+    uint32_t data = 0;
+    for (size_t b = 0; b < size; b++) data |= uint32_t(map[i + 1 + b]) << (8 * b);
+    switch (prefix & 0xFC) {
+      case 0x74: report_size = data; break;   // Report Size
+      case 0x94: report_count = data; break;  // Report Count
+      case 0x84: report_id = data; break;     // Report ID
+      case 0x80: sizes.input[report_id] += report_size * report_count; break;   // Input
+      case 0x90: sizes.output[report_id] += report_size * report_count; break;  // Output
+      case 0xA0: depth++; break;              // Collection
+      case 0xC0:                              // End Collection
+        if (--depth < 0) return sizes;
+        break;
+    }
+    i += 1 + size;
+  }
+  sizes.valid = depth == 0;
+  return sizes;
+}
+
+// Input reports the build should have, and the bits the component sends
+static std::map<uint8_t, uint32_t> expected_inputs() {
+  std::map<uint8_t, uint32_t> bits{{uint8_t(KeyboardHarness::REPORT_KEYBOARD), 8 * 8}};
+#if ESPIDF_BLE_KEYBOARD_CONSUMER
+  bits[uint8_t(KeyboardHarness::REPORT_CONSUMER)] = 2 * 8;
+#endif
+#if ESPIDF_BLE_KEYBOARD_SYSTEM
+  bits[uint8_t(KeyboardHarness::REPORT_SYSTEM)] = 1 * 8;
+#endif
+#if ESPIDF_BLE_KEYBOARD_NKRO
+  bits[uint8_t(KeyboardHarness::REPORT_NKRO)] = NKRO_REPORT_LEN * 8;
+#endif
+#if ESPIDF_BLE_KEYBOARD_MOUSE
+  bits[uint8_t(KeyboardHarness::REPORT_MOUSE)] = MOUSE_REPORT_LEN * 8;
+#endif
+  return bits;
+}
+
+static const mock::Attribute *attribute(KeyboardHarness &h, uint16_t handle) {
+  for (const auto &attr : h.bt().attributes) {
+    if (attr.handle == handle) return &attr;
+  }
+  return nullptr;
+}
+
+TEST_CASE(report_map_has_the_configured_reports) {
+  KeyboardHarness h;
+  CHECK(h.start());
+  const mock::Attribute *map = attribute(h, h.handle_of(ESP_GATT_UUID_HID_REPORT_MAP));
+  CHECK(map != nullptr);
+  if (map == nullptr) return;
+  ReportSizes sizes = parse_report_map(map->value);
+  CHECK(sizes.valid);
+  CHECK(sizes.input == expected_inputs());
+  // Only the keyboard has an output report, for the lock LEDs
+  CHECK_EQ(sizes.output.size(), size_t(1));
+  CHECK_EQ(sizes.output[uint8_t(KeyboardHarness::REPORT_KEYBOARD)], uint32_t(8));
+}
+
+TEST_CASE(attribute_table_matches_the_report_map) {
+  KeyboardHarness h;
+  CHECK(h.start());
+  std::map<uint8_t, uint32_t> inputs = expected_inputs();
+  for (uint8_t id = KeyboardHarness::REPORT_KEYBOARD; id <= KeyboardHarness::REPORT_MOUSE; id++) {
+    uint16_t handle = h.input_report_handle(id);
+    if (inputs.count(id) == 0) {
+      CHECK_EQ(handle, uint16_t(0));
+      continue;
+    }
+    const mock::Attribute *value = attribute(h, handle);
+    CHECK(value != nullptr);
+    if (value == nullptr) continue;
+    CHECK_EQ(value->value.size() * 8, size_t(inputs[id]));
+    CHECK_NE(h.ccc_handle(handle), uint16_t(0));
+  }
+  const mock::Attribute *leds = attribute(h, h.output_report_handle(KeyboardHarness::REPORT_KEYBOARD));
+  CHECK(leds != nullptr && leds->value.size() == 1);
+
+  // One Report Reference per input report, plus the LED output report
+  size_t refs = 0;
+  for (const auto &attr : h.bt().attributes) refs += attr.uuid == ESP_GATT_UUID_RPT_REF_DESCR;
+  CHECK_EQ(refs, inputs.size() + 1);
+}
+
+TEST_CASE(held_keys_use_the_configured_report) {
+  KeyboardHarness h;
+  CHECK(h.start());
+  uint16_t conn = h.connect(1);
+  h.run_for(100);
+  CHECK(h.kb().press(KEY_A));
+  CHECK(h.run_until_idle());
+#if ESPIDF_BLE_KEYBOARD_NKRO
+  auto nkro = h.reports(conn, KeyboardHarness::REPORT_NKRO);
+  CHECK(!nkro.empty() && nkro.back().data.size() == NKRO_REPORT_LEN &&
+        (nkro.back().data[1 + KEY_A / 8] & (1 << (KEY_A % 8))));
+#else
+  // Without the NKRO report, held keys go out on the keyboard report
+  auto keyboard = h.reports(conn, KeyboardHarness::REPORT_KEYBOARD);
+  CHECK(!keyboard.empty() && keyboard.back().data.size() == 8 && keyboard.back().data[2] == KEY_A);
+#endif
+  CHECK(h.kb().release(KEY_A));
+  CHECK(h.run_until_idle());
+}
+
+#if ESPIDF_BLE_KEYBOARD_MOUSE
+TEST_CASE(mouse_reports_reach_the_host) {
+  KeyboardHarness h;
+  CHECK(h.start());
+  uint16_t conn = h.connect(1);
+  h.run_for(100);
+  h.kb().mouse_move(5, -5, 1);
+  CHECK(h.run_until_idle());
+  auto mouse = h.reports(conn, KeyboardHarness::REPORT_MOUSE);
+  CHECK_EQ(mouse.size(), size_t(1));
+  if (mouse.empty()) return;
+  CHECK(mouse[0].data == std::vector<uint8_t>({0x00, 0x05, 0xFB, 0x01}));
+}
+#endif
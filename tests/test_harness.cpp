@@ -0,0 +1,148 @@
+// End-to-end checks of the harness itself: the component starts on the mock
+// stack, a host connects, and what it types arrives as HID notifications.
+#include "check.h"
+#include "esp_gatt_defs.h"
+#include "harness.h"
+
+using testing::KeyboardHarness;
+
+TEST_CASE(startup_creates_table_and_advertises) {
+  KeyboardHarness h;
+  CHECK(h.start());
+  CHECK(h.bt().registered());
+  CHECK_NE(h.input_report_handle(KeyboardHarness::REPORT_KEYBOARD), 0);
+  CHECK_NE(h.output_report_handle(KeyboardHarness::REPORT_KEYBOARD), 0);
+  CHECK_NE(h.ccc_handle(h.input_report_handle(KeyboardHarness::REPORT_CONSUMER)), 0);
+  CHECK_EQ(h.bt().adv_starts.size(), size_t(1));
+  CHECK(!h.kb().is_failed());
+}
+
+TEST_CASE(typed_text_arrives_in_order) {
+  KeyboardHarness h;
+  CHECK(h.start());
+  uint16_t conn = h.connect(1);
+  CHECK(h.kb().is_connected());
+  h.run_for(100);
+  h.kb().send_string("Hello, World!");
+  CHECK(h.run_until_idle());
+  CHECK_EQ(h.typed_text(conn), std::string("Hello, World!"));
+  // The last report releases everything
+  auto reports = h.reports(conn, KeyboardHarness::REPORT_KEYBOARD);
+  CHECK(!reports.empty());
+  if (!reports.empty()) CHECK(reports.back().data == std::vector<uint8_t>(8, 0));
+}
+
+TEST_CASE(notifications_carry_virtual_timestamps) {
+  KeyboardHarness h;
+  CHECK(h.start());
+  uint16_t conn = h.connect(1);
+  h.run_for(100);
+  uint32_t sent_at = mock::now_ms();
+  h.kb().send_string("abc");
+  CHECK(h.run_until_idle());
+  auto reports = h.reports(conn, KeyboardHarness::REPORT_KEYBOARD);
+  CHECK_GE(reports.size(), size_t(2));
+  for (size_t i = 0; i < reports.size(); i++) {
+    CHECK_GE(reports[i].ms, sent_at);
+    if (i > 0) CHECK_GE(reports[i].ms, reports[i - 1].ms);
+  }
+}
+
+TEST_CASE(nothing_is_sent_without_a_subscription) {
+  KeyboardHarness h;
+  CHECK(h.start());
+  uint16_t conn = h.connect(1, 6, false);
+  h.run_for(100);
+  h.kb().send_string("abc");
+  h.run_for(500);
+  CHECK(h.reports(conn, KeyboardHarness::REPORT_KEYBOARD).empty());
+}
+
+TEST_CASE(passkey_pairing_bonds_and_reconnects) {
+  {
+    KeyboardHarness h;
+    h.kb().set_passkey(123456);
+    CHECK(h.start());
+    uint16_t conn = h.connect(1);
+    CHECK_EQ(h.bt().encryption_requests.size(), size_t(1));
+    CHECK(h.bt().link(conn) != nullptr && h.bt().link(conn)->encrypted);
+    CHECK(h.bt().bonded(KeyboardHarness::address(1)));
+    h.run_for(100);
+    h.kb().send_string("ok");
+    CHECK(h.run_until_idle());
+    CHECK_EQ(h.typed_text(conn), std::string("ok"));
+  }
+  // After a reboot the bonded host encrypts by itself and is served again
+  KeyboardHarness h(true);
+  h.kb().set_passkey(123456);
+  CHECK(h.start());
+  CHECK_EQ(h.kb().bond_count(), uint8_t(1));
+  uint16_t conn = h.connect(1);
+  h.run_for(100);
+  h.kb().send_string("again");
+  CHECK(h.run_until_idle());
+  CHECK_EQ(h.typed_text(conn), std::string("again"));
+}
+
+TEST_CASE(just_works_bond_keeps_subscriptions) {
+  {
+    KeyboardHarness h;
+    CHECK(h.start());
+    uint16_t conn = h.connect(1, 6, false);
+    // Without a passkey the host pairs on its own, then subscribes
+    h.bt().encrypt(conn);
+    CHECK(h.run_until([&h, conn]() { return h.bt().link(conn)->encrypted; }, 2000));
+    h.subscribe_all(conn);
+    h.run_for(100);
+    CHECK_EQ(h.kb().bond_count(), uint8_t(1));
+  }
+  // After a reboot the host encrypts by itself and relies on the CCCs
+  // stored at bonding
+  KeyboardHarness h(true);
+  CHECK(h.start());
+  uint16_t conn = h.connect(1, 6, false);
+  h.run_for(100);
+  h.kb().send_string("again");
+  CHECK(h.run_until_idle());
+  CHECK_EQ(h.typed_text(conn), std::string("again"));
+}
+
+TEST_CASE(led_output_report_is_injected) {
+  KeyboardHarness h;
+  CHECK(h.start());
+  uint16_t conn = h.connect(1);
+  CHECK(!h.kb().caps_lock());
+  h.set_leds(conn, 0x02);
+  h.run_for(20);
+  CHECK(h.kb().caps_lock());
+  h.set_leds(conn, 0x00);
+  h.run_for(20);
+  CHECK(!h.kb().caps_lock());
+}
+
+TEST_CASE(disconnect_restarts_advertising) {
+  KeyboardHarness h;
+  CHECK(h.start());
+  uint16_t conn = h.connect(1);
+  CHECK(!h.bt().advertising);
+  h.bt().disconnect(conn);
+  CHECK(h.run_until([&h]() { return h.bt().advertising; }, 2000));
+  CHECK(!h.kb().is_connected());
+}
+
+TEST_CASE(boot_host_skips_media_keys_and_keeps_typing) {
+  // A BIOS writes only the boot keyboard CCC and switches to boot protocol
+  KeyboardHarness h;
+  CHECK(h.start());
+  uint16_t conn = h.connect(1, 6, false);
+  h.bt().write(conn, h.handle_of(ESP_GATT_UUID_HID_PROTO_MODE), {0x00});
+  h.bt().write(conn, h.ccc_handle(h.handle_of(ESP_GATT_UUID_HID_BT_KB_INPUT)), {0x01, 0x00});
+  h.run_for(100);
+  h.kb().send_volume_up();
+  h.kb().send_string("abc");
+  CHECK(h.run_until_idle(5000));
+  CHECK_EQ(h.kb().queued_reports(), size_t(0));
+  CHECK_EQ(h.typed_text(conn), std::string("abc"));
+  CHECK(h.reports(conn, KeyboardHarness::REPORT_CONSUMER).empty());
+  CHECK(!h.bt().notifications_on(conn, h.handle_of(ESP_GATT_UUID_HID_BT_KB_INPUT)).empty());
+}
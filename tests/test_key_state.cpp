@@ -0,0 +1,81 @@
+// Held keys (press/release, hold): the NKRO key state report must reach the
+// host even when the report queue is full at the moment a key is released.
+#include "check.h"
+#include "harness.h"
+
+using testing::KeyboardHarness;
+using namespace esphome::espidf_ble_keyboard;
+
+static uint16_t ready_host(KeyboardHarness &h) {
+  h.kb().set_keys_per_report(1);
+  h.start();
+  uint16_t conn = h.connect(1);
+  h.run_for(100);
+  return conn;
+}
+
+static bool key_down(const mock::Notification &report, uint8_t keycode) {
+  return report.data.size() == NKRO_REPORT_LEN && (report.data[1 + keycode / 8] & (1 << (keycode % 8)));
+}
+
+// Fills the queue with taps while the link is congested, so nothing drains
+static void fill_queue(KeyboardHarness &h, uint16_t conn) {
+  h.bt().set_congested(conn, true);
+  for (size_t i = 0; i < REPORT_QUEUE_SIZE / 2; i++) h.kb().send_key_combo(0, KEY_SPACE);
+  CHECK_EQ(h.kb().queued_reports(), REPORT_QUEUE_SIZE);
+}
+
+static const std::vector<uint8_t> NO_KEYS(NKRO_REPORT_LEN, 0);
+
+TEST_CASE(hold_release_survives_a_full_queue) {
+  KeyboardHarness h;
+  uint16_t conn = ready_host(h);
+  CHECK(h.kb().hold(0, KEY_A, 50));
+  h.run_for(20);
+  auto nkro = h.reports(conn, KeyboardHarness::REPORT_NKRO);
+  CHECK(!nkro.empty() && key_down(nkro.back(), KEY_A));
+  fill_queue(h, conn);
+  h.run_for(100);  // the hold ends while the queue is full
+  CHECK(!h.kb().is_pressed(KEY_A));
+  h.bt().set_congested(conn, false);
+  CHECK(h.run_until_idle());
+  nkro = h.reports(conn, KeyboardHarness::REPORT_NKRO);
+  CHECK(!nkro.empty() && nkro.back().data == NO_KEYS);
+}
+
+TEST_CASE(hold_is_refused_on_a_full_queue) {
+  KeyboardHarness h;
+  uint16_t conn = ready_host(h);
+  fill_queue(h, conn);
+  CHECK(!h.kb().hold(0, KEY_A, 50));
+  CHECK(!h.kb().is_pressed(KEY_A));
+  h.bt().set_congested(conn, false);
+  CHECK(h.run_until_idle());
+  CHECK(h.reports(conn, KeyboardHarness::REPORT_NKRO).empty());
+}
+
+TEST_CASE(release_survives_a_full_queue) {
+  KeyboardHarness h;
+  uint16_t conn = ready_host(h);
+  CHECK(h.kb().press(KEY_A));
+  CHECK(h.kb().press(0xE1));  // Left Shift
+  h.run_for(50);
+  fill_queue(h, conn);
+  CHECK(h.kb().release(KEY_A));
+  h.kb().release_all();
+  h.bt().set_congested(conn, false);
+  CHECK(h.run_until_idle());
+  auto nkro = h.reports(conn, KeyboardHarness::REPORT_NKRO);
+  CHECK(!nkro.empty() && nkro.back().data == NO_KEYS);
+}
+
+TEST_CASE(press_is_refused_on_a_full_queue) {
+  KeyboardHarness h;
+  uint16_t conn = ready_host(h);
+  fill_queue(h, conn);
+  CHECK(!h.kb().press(KEY_A));
+  CHECK(!h.kb().is_pressed(KEY_A));
+  h.bt().set_congested(conn, false);
+  CHECK(h.run_until_idle());
+  CHECK(h.reports(conn, KeyboardHarness::REPORT_NKRO).empty());
+}
@@ -0,0 +1,128 @@
+// Layout tables, built once per layout (see CMakeLists.txt): every printable
+// ASCII character maps to its own keystrokes, Caps Lock inverts Shift for
+// letters only, and typed text reaches the host without losing a character.
+#include <map>
+#include <utility>
+
+#include "check.h"
+#include "esphome/core/log.h"
+#include "harness.h"
+#include "hid_keymap.h"
+
+using testing::KeyboardHarness;
+using namespace esphome::espidf_ble_keyboard;
+
+using Strokes = std::vector<std::pair<uint8_t, uint8_t>>;
+
+static Strokes strokes_for(const CharMapping &mapping) {
+  Strokes strokes;
+  if (mapping.dead.keycode != 0) strokes.push_back({mapping.dead.modifier, mapping.dead.keycode});
+  strokes.push_back({mapping.key.modifier, mapping.key.keycode});
+  return strokes;
+}
+
+static std::string printable_ascii() {
+  std::string text;
+  for (char c = ' '; c <= '~'; c++) text += c;
+  return text;
+}
+
+TEST_CASE(printable_ascii_maps_to_distinct_keystrokes) {
+  std::map<Strokes, char> seen;
+  for (char c : printable_ascii()) {
+    CharMapping mapping = lookup_char(uint8_t(c));
+    CHECK_NE(mapping.key.keycode, 0);
+    auto inserted = seen.insert({strokes_for(mapping), c});
+    if (!inserted.second) fprintf(stderr, "[%s] '%c' types like '%c'\n", LAYOUT_NAME, c, inserted.first->second);
+    CHECK(inserted.second);
+  }
+  CHECK_EQ(lookup_char('\n').key.keycode, KEY_ENTER);
+  CHECK_EQ(lookup_char('\t').key.keycode, KEY_TAB);
+}
+
+TEST_CASE(ascii_table_round_trips) {
+  // Whatever the ASCII table holds decodes back to the same character
+  for (int c = 0; c < 128; c++) {
+    KeyStroke key = LAYOUT_KEYMAP.keys[c];
+    if (key.keycode == 0) continue;
+    int found = -1;
+    for (int other = 0; other < 128 && found < 0; other++) {
+      if (LAYOUT_KEYMAP.keys[other].keycode == key.keycode && LAYOUT_KEYMAP.keys[other].modifier == key.modifier)
+        found = other;
+    }
+    CHECK_EQ(found, c);
+  }
+}
+
+TEST_CASE(caps_lock_inverts_shift_for_letters_only) {
+  for (uint32_t c = 'a'; c <= 'z'; c++) {
+    CharMapping lower = lookup_char(c), caps = lookup_char(c, true);
+    CHECK_EQ(caps.key.keycode, lower.key.keycode);
+    CHECK_EQ(caps.key.modifier, uint8_t(lower.key.modifier ^ KEY_MOD_LSHIFT));
+    CharMapping upper_caps = lookup_char(c - 0x20, true);
+    CHECK_EQ(upper_caps.key.modifier, lower.key.modifier);
+  }
+  for (char c : std::string("0123456789.,-!?@ ")) {
+    CharMapping plain = lookup_char(uint8_t(c)), caps = lookup_char(uint8_t(c), true);
+    CHECK_EQ(caps.key.modifier, plain.key.modifier);
+    CHECK_EQ(caps.key.keycode, plain.key.keycode);
+  }
+  // Layout letters outside ASCII follow the same rule when both cases exist
+  for (size_t i = 0; i < LAYOUT_EXTENDED_COUNT; i++) {
+    uint32_t cp = LAYOUT_EXTENDED[i].codepoint;
+    if (cp < 0xE0 || cp > 0xFE || cp == 0xF7) continue;
+    CharMapping upper = lookup_char(cp - 0x20);
+    if (upper.key.keycode != LAYOUT_EXTENDED[i].key.keycode) continue;
+    CHECK_EQ(lookup_char(cp, true).key.modifier, upper.key.modifier);
+  }
+}
+
+TEST_CASE(utf8_decoding) {
+  const std::string text = "a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\xC3";  // a é € 😀, truncated
+  const char *p = text.data(), *end = p + text.size();
+  CHECK_EQ(utf8_next(p, end), uint32_t('a'));
+  CHECK_EQ(utf8_next(p, end), uint32_t(0xE9));
+  CHECK_EQ(utf8_next(p, end), uint32_t(0x20AC));
+  CHECK_EQ(utf8_next(p, end), uint32_t(0x1F600));
+  CHECK_EQ(utf8_next(p, end), uint32_t(0xFFFD));
+  CHECK(p == end);
+  CHECK_EQ(lookup_char(0xFFFD).key.keycode, 0);
+}
+
+// Keystrokes the host saw pressed, in order, from the keyboard reports
+static Strokes pressed_strokes(KeyboardHarness &h, uint16_t conn) {
+  Strokes strokes;
+  uint8_t held[6] = {0};
+  for (const auto &n : h.reports(conn, KeyboardHarness::REPORT_KEYBOARD)) {
+    for (int i = 2; i < 8; i++) {
+      if (n.data[i] != 0 && std::find(held, held + 6, n.data[i]) == held + 6) strokes.push_back({n.data[0], n.data[i]});
+    }
+    std::copy(n.data.begin() + 2, n.data.begin() + 8, held);
+  }
+  return strokes;
+}
+
+TEST_CASE(no_printable_character_is_dropped) {
+  for (bool caps : {false, true}) {
+    KeyboardHarness h;
+    h.start();
+    uint16_t conn = h.connect(1);
+    if (caps) h.set_leds(conn, 0x02);
+    h.run_for(100);
+    // Two halves, so the dead keys of either fit the report queue
+    std::string text = printable_ascii() + "\n\t";
+    Strokes expected;
+    for (size_t half = 0; half < text.size(); half += text.size() / 2) {
+      std::string part = text.substr(half, text.size() / 2);
+      h.kb().send_string(part);
+      CHECK(h.run_until_idle());
+      for (char c : part) {
+        Strokes s = strokes_for(lookup_char(uint8_t(c), caps));
+        expected.insert(expected.end(), s.begin(), s.end());
+      }
+    }
+    CHECK(pressed_strokes(h, conn) == expected);
+    CHECK_EQ(h.kb().notifications_dropped(), uint32_t(0));
+    CHECK_EQ(mock::log_count(ESPHOME_LOG_LEVEL_WARN), uint32_t(0));
+  }
+}
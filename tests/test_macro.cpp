@@ -0,0 +1,107 @@
+// Macro player: steps become queued reports, DELAY holds back the next one,
+// and a malformed macro never leaves a key held down.
+#include "check.h"
+#include "harness.h"
+#include "esphome/core/log.h"
+#include "macro.h"
+
+using testing::KeyboardHarness;
+using namespace esphome::espidf_ble_keyboard;
+
+static const uint8_t KEY_B = KEY_A + 1;
+
+static uint16_t ready_host(KeyboardHarness &h) {
+  h.start();
+  uint16_t conn = h.connect(1);
+  h.run_for(100);
+  return conn;
+}
+
+TEST_CASE(tap_delay_tap_keeps_the_delay) {
+  static const uint8_t MACRO[] = {
+      MACRO_OP_TAP, KEY_MOD_LCTRL, KEY_A,
+      MACRO_OP_DELAY, MACRO_U16(300),
+      MACRO_OP_TAP, 0, KEY_B,
+  };
+  KeyboardHarness h;
+  uint16_t conn = ready_host(h);
+  CHECK(h.kb().play_macro(MACRO, sizeof(MACRO)));
+  CHECK(h.run_until_idle());
+  auto reports = h.reports(conn, KeyboardHarness::REPORT_KEYBOARD);
+  CHECK_EQ(reports.size(), size_t(4));
+  if (reports.size() != 4) return;
+  CHECK_EQ(reports[0].data[0], KEY_MOD_LCTRL);
+  CHECK_EQ(reports[0].data[2], KEY_A);
+  CHECK_EQ(reports[1].data[2], 0);
+  CHECK_EQ(reports[2].data[2], KEY_B);
+  CHECK_GE(reports[2].ms - reports[1].ms, uint32_t(300));
+}
+
+TEST_CASE(type_step_uses_the_layout) {
+  static const uint8_t MACRO[] = {
+      MACRO_OP_TYPE, 5, 'h', 'e', 'l', 'l', 'o',
+      MACRO_OP_TAP, 0, KEY_ENTER,
+  };
+  KeyboardHarness h;
+  uint16_t conn = ready_host(h);
+  CHECK(h.kb().play_macro(MACRO, sizeof(MACRO)));
+  CHECK(h.run_until_idle());
+  CHECK_EQ(h.typed_text(conn), std::string("hello\n"));
+}
+
+TEST_CASE(consumer_and_system_steps) {
+  static const uint8_t MACRO[] = {
+      MACRO_OP_CONSUMER, MACRO_U16(0x00E9),  // Volume Up
+      MACRO_OP_SYSTEM, 0x82,                 // Sleep
+  };
+  KeyboardHarness h;
+  uint16_t conn = ready_host(h);
+  CHECK(h.kb().play_macro(MACRO, sizeof(MACRO)));
+  CHECK(h.run_until_idle());
+  auto consumer = h.reports(conn, KeyboardHarness::REPORT_CONSUMER);
+  CHECK_EQ(consumer.size(), size_t(2));
+  if (consumer.size() == 2) {
+    CHECK(consumer[0].data == std::vector<uint8_t>({0xE9, 0x00}));
+    CHECK(consumer[1].data == std::vector<uint8_t>({0x00, 0x00}));
+  }
+  auto system = h.reports(conn, KeyboardHarness::REPORT_SYSTEM);
+  CHECK_EQ(system.size(), size_t(2));
+  if (system.size() == 2) {
+    CHECK_EQ(system[0].data[0], 0x82);
+    CHECK_EQ(system[1].data[0], 0);
+  }
+}
+
+TEST_CASE(malformed_macro_releases_held_keys) {
+  static const uint8_t MACRO[] = {
+      MACRO_OP_PRESS, KEY_MOD_LCTRL, KEY_A,
+      0x7F,  // not an opcode
+      MACRO_OP_TAP, 0, KEY_B,
+  };
+  KeyboardHarness h;
+  uint16_t conn = ready_host(h);
+  CHECK(h.kb().play_macro(MACRO, sizeof(MACRO)));
+  CHECK(h.run_until_idle());
+  auto reports = h.reports(conn, KeyboardHarness::REPORT_KEYBOARD);
+  CHECK_EQ(reports.size(), size_t(2));
+  if (!reports.empty()) CHECK(reports.back().data == std::vector<uint8_t>(8, 0));
+  CHECK_EQ(mock::log_count(ESPHOME_LOG_LEVEL_ERROR), uint32_t(1));
+}
+
+TEST_CASE(macros_play_one_after_another) {
+  static const uint8_t FIRST[] = {MACRO_OP_TYPE, 2, 'a', 'b'};
+  static const uint8_t SECOND[] = {MACRO_OP_TYPE, 2, 'c', 'd'};
+  KeyboardHarness h;
+  uint16_t conn = ready_host(h);
+  CHECK(h.kb().play_macro(FIRST, sizeof(FIRST)));
+  CHECK(h.kb().play_macro(SECOND, sizeof(SECOND)));
+  CHECK(h.run_until_idle());
+  CHECK_EQ(h.typed_text(conn), std::string("abcd"));
+}
+
+TEST_CASE(no_macro_without_a_host) {
+  static const uint8_t MACRO[] = {MACRO_OP_TAP, 0, KEY_A};
+  KeyboardHarness h;
+  CHECK(h.start());
+  CHECK(!h.kb().play_macro(MACRO, sizeof(MACRO)));
+}
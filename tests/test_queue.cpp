@@ -0,0 +1,185 @@
+// Report queue and pacing: send_* only enqueue, loop() sends one report per
+// connection event with at most MAX_IN_FLIGHT unconfirmed, and congestion,
+// failed sends and a full queue never cost a release.
+#include <chrono>
+#include <cstdio>
+
+#include "check.h"
+#include "esphome/core/log.h"
+#include "harness.h"
+
+using testing::KeyboardHarness;
+using namespace esphome::espidf_ble_keyboard;
+
+// One key per report, so every character is a press and a release
+static uint16_t ready_host(KeyboardHarness &h, uint16_t interval = 6) {
+  h.kb().set_keys_per_report(1);
+  h.start();
+  uint16_t conn = h.connect(1, interval);
+  h.run_for(100);
+  return conn;
+}
+
+// Keyboard reports alternate press and all-zero release
+static bool every_press_released(const std::vector<mock::Notification> &reports) {
+  const std::vector<uint8_t> release(8, 0);
+  for (size_t i = 0; i < reports.size(); i++) {
+    if ((reports[i].data == release) != (i % 2 == 1)) return false;
+  }
+  return reports.size() % 2 == 0;
+}
+
+TEST_CASE(send_string_returns_without_blocking) {
+  KeyboardHarness h;
+  uint16_t conn = ready_host(h);
+  // Longer than the queue holds; the rest is typed from loop()
+  std::string text;
+  while (text.size() < 1000) text += "The quick brown fox jumps over the lazy dog. ";
+  uint32_t now = mock::now_ms(), blocked = mock::blocked_ms();
+  size_t sent = h.bt().notifications.size();
+  auto t0 = std::chrono::steady_clock::now();
+  h.kb().send_string(text);
+  auto wall_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+  printf("send_string of %zu chars: %lld us wall, %u ms virtual\n", text.size(), (long long) wall_us,
+         (unsigned) (mock::now_ms() - now));
+  CHECK_EQ(mock::now_ms(), now);
+  CHECK_EQ(mock::blocked_ms(), blocked);
+  CHECK_EQ(h.bt().notifications.size(), sent);
+  CHECK_LE(h.kb().queued_reports(), REPORT_QUEUE_SIZE);
+  CHECK(h.kb().text_pending());
+  CHECK(h.run_until_idle(120000));
+  CHECK_EQ(h.typed_text(conn), text);
+}
+
+TEST_CASE(reports_are_paced_by_the_connection_interval) {
+  // 30 ms interval: one report per connection event
+  KeyboardHarness h;
+  uint16_t conn = ready_host(h, 24);
+  h.kb().send_string("pacing");
+  CHECK(h.run_until_idle());
+  auto reports = h.reports(conn, KeyboardHarness::REPORT_KEYBOARD);
+  CHECK_GE(reports.size(), size_t(4));
+  for (size_t i = 1; i < reports.size(); i++) CHECK_GE(reports[i].ms - reports[i - 1].ms, uint32_t(30));
+}
+
+TEST_CASE(reports_are_paced_by_min_report_interval) {
+  // 7.5 ms interval, but no faster than every 25 ms
+  KeyboardHarness h;
+  h.kb().set_min_report_interval(25);
+  uint16_t conn = ready_host(h, 6);
+  h.kb().send_string("pacing");
+  CHECK(h.run_until_idle());
+  auto reports = h.reports(conn, KeyboardHarness::REPORT_KEYBOARD);
+  CHECK_GE(reports.size(), size_t(4));
+  for (size_t i = 1; i < reports.size(); i++) CHECK_GE(reports[i].ms - reports[i - 1].ms, uint32_t(25));
+}
+
+TEST_CASE(in_flight_limit_waits_for_confirmations) {
+  KeyboardHarness h;
+  uint16_t conn = ready_host(h);
+  h.bt().notifications_per_event = 0;  // nothing gets confirmed
+  uint32_t sent = h.bt().send_calls;
+  h.kb().send_string("abcdef");
+  h.run_for(200);
+  CHECK_EQ(h.bt().send_calls - sent, uint32_t(MAX_IN_FLIGHT));
+  h.bt().notifications_per_event = 4;
+  CHECK(h.run_until_idle());
+  CHECK_EQ(h.typed_text(conn), std::string("abcdef"));
+}
+
+TEST_CASE(missing_confirmations_do_not_stall_the_queue) {
+  KeyboardHarness h;
+  ready_host(h);
+  h.bt().notifications_per_event = 0;
+  uint32_t sent = h.bt().send_calls;
+  h.kb().send_string("abcdef");
+  h.run_for(1000);
+  // Gives up on the confirmations after 500 ms and sends the next ones
+  CHECK_GT(h.bt().send_calls - sent, uint32_t(MAX_IN_FLIGHT));
+}
+
+TEST_CASE(congestion_pauses_sending) {
+  KeyboardHarness h;
+  uint16_t conn = ready_host(h);
+  h.bt().set_congested(conn, true);
+  h.kb().send_string("congested");
+  h.run_for(300);
+  CHECK(h.reports(conn, KeyboardHarness::REPORT_KEYBOARD).empty());
+  CHECK_EQ(h.kb().congestion_events(), uint32_t(1));
+  h.bt().set_congested(conn, false);
+  CHECK(h.run_until_idle());
+  CHECK_EQ(h.typed_text(conn), std::string("congested"));
+}
+
+TEST_CASE(failed_sends_are_retried) {
+  KeyboardHarness h;
+  uint16_t conn = ready_host(h);
+  h.bt().fail_sends = MAX_SEND_RETRIES - 1;
+  h.kb().send_string("retry");
+  CHECK(h.run_until_idle());
+  CHECK_EQ(h.typed_text(conn), std::string("retry"));
+  CHECK_EQ(h.kb().notifications_retried(), uint32_t(MAX_SEND_RETRIES - 1));
+  CHECK_EQ(h.kb().notifications_dropped(), uint32_t(0));
+}
+
+TEST_CASE(report_is_dropped_after_max_retries) {
+  KeyboardHarness h;
+  uint16_t conn = ready_host(h);
+  h.bt().fail_sends = MAX_SEND_RETRIES;
+  h.kb().send_string("xy");
+  CHECK(h.run_until_idle());
+  // The press of 'x' is lost, its release still goes out
+  CHECK_EQ(h.typed_text(conn), std::string("y"));
+  CHECK_EQ(h.kb().notifications_dropped(), uint32_t(1));
+  auto reports = h.reports(conn, KeyboardHarness::REPORT_KEYBOARD);
+  CHECK(!reports.empty() && reports.back().data == std::vector<uint8_t>(8, 0));
+}
+
+TEST_CASE(full_queue_never_strands_a_press) {
+  KeyboardHarness h;
+  uint16_t conn = ready_host(h);
+  std::string text;
+  for (int i = 0; i < 100; i++) text += char('a' + i % 26);
+  h.kb().send_string(text);
+  CHECK(h.kb().text_pending());
+  CHECK(h.run_until_idle());
+  CHECK_EQ(h.typed_text(conn), text);
+  CHECK(every_press_released(h.reports(conn, KeyboardHarness::REPORT_KEYBOARD)));
+}
+
+TEST_CASE(queued_reports_burst_once_the_host_is_ready) {
+  KeyboardHarness h;
+  h.kb().set_keys_per_report(1);
+  h.start();
+  uint16_t conn = h.connect(1, 24, false);
+  h.run_for(100);
+  h.kb().send_string("burst");
+  h.run_for(100);
+  CHECK(h.reports(conn, KeyboardHarness::REPORT_KEYBOARD).empty());
+  h.subscribe_all(conn);
+  CHECK(h.run_until_idle());
+  CHECK_EQ(h.typed_text(conn), std::string("burst"));
+  // Sent back to back rather than one per 30 ms connection event
+  auto reports = h.reports(conn, KeyboardHarness::REPORT_KEYBOARD);
+  CHECK_EQ(reports.size(), size_t(10));
+  if (reports.size() >= BURST_MAX_IN_FLIGHT)
+    CHECK_LT(reports[BURST_MAX_IN_FLIGHT - 1].ms - reports[0].ms, uint32_t(30));
+}
+
+TEST_CASE(long_text_stays_on_its_host) {
+  KeyboardHarness h;
+  h.kb().set_keys_per_report(1);
+  h.start();
+  uint16_t a = h.connect(1);
+  uint16_t b = h.connect(2);
+  h.run_for(100);
+  h.kb().select_host(0);
+  std::string text(200, 'x');
+  h.kb().send_string(text);
+  // The rest of the text still goes to host 0, ahead of later text
+  h.kb().select_host(1);
+  h.kb().send_string("y");
+  CHECK(h.run_until_idle(120000));
+  CHECK_EQ(h.typed_text(a), text);
+  CHECK_EQ(h.typed_text(b), std::string("y"));
+}
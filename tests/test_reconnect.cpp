@@ -0,0 +1,58 @@
+// Fast reconnect and host slots for bonded hosts, with public addresses and
+// with resolvable private addresses that change on every connection.
+#include <cstring>
+
+#include "check.h"
+#include "harness.h"
+
+using testing::KeyboardHarness;
+
+static const uint32_t PASSKEY = 123456;
+
+// After the host disconnects, the keyboard should advertise directed at it
+static void check_directed_after_disconnect(bool private_address) {
+  KeyboardHarness h;
+  h.kb().set_passkey(PASSKEY);
+  h.kb().set_fast_reconnect(10000);
+  CHECK(h.start());
+  uint16_t conn = h.connect(1, 6, true, private_address);
+  CHECK(h.bt().bonded(KeyboardHarness::address(1)));
+  h.run_for(100);
+  size_t starts = h.bt().adv_starts.size();
+  h.bt().disconnect(conn);
+  h.run_for(100);
+  CHECK_GT(h.bt().adv_starts.size(), starts);
+  if (h.bt().adv_starts.size() == starts) return;
+  const esp_ble_adv_params_t &adv = h.bt().adv_starts[starts];
+  CHECK_EQ(int(adv.adv_type), int(ADV_TYPE_DIRECT_IND_HIGH));
+  CHECK(memcmp(adv.peer_addr, KeyboardHarness::address(1).data(), ESP_BD_ADDR_LEN) == 0);
+}
+
+TEST_CASE(directed_advertising_for_a_public_address_host) { check_directed_after_disconnect(false); }
+
+TEST_CASE(directed_advertising_for_a_private_address_host) { check_directed_after_disconnect(true); }
+
+TEST_CASE(private_address_host_gets_its_slot_back) {
+  KeyboardHarness h;
+  h.kb().set_passkey(PASSKEY);
+  CHECK(h.start());
+  uint16_t a = h.connect(1, 6, true, true);
+  uint16_t b = h.connect(2, 6, true, true);
+  CHECK(h.kb().is_host_connected(0));
+  CHECK(h.kb().is_host_connected(1));
+  h.bt().disconnect(b);
+  h.run_for(100);
+  CHECK(!h.kb().is_host_connected(1));
+
+  // B comes back from a new address; its identity puts it in slot 1 again
+  b = h.connect(2, 6, true, true);
+  h.run_for(100);
+  CHECK(h.kb().is_host_connected(0));
+  CHECK(h.kb().is_host_connected(1));
+  CHECK(!h.kb().is_host_connected(2));
+  h.kb().select_host(1);
+  h.kb().send_string("to b");
+  CHECK(h.run_until_idle());
+  CHECK_EQ(h.typed_text(b), std::string("to b"));
+  CHECK_EQ(h.typed_text(a), std::string(""));
+}
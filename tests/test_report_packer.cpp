@@ -0,0 +1,104 @@
+// KeyReportPacker flush rules, and what packing saves on the air: the same
+// corpus typed with one key per report and with six.
+#include <cstdio>
+
+#include "check.h"
+#include "harness.h"
+#include "report_packer.h"
+
+using testing::KeyboardHarness;
+using namespace esphome::espidf_ble_keyboard;
+
+static const uint8_t KEY_B = KEY_A + 1;
+static const uint8_t KEY_C = KEY_A + 2;
+
+TEST_CASE(distinct_keys_share_a_report) {
+  KeyReportPacker packer;
+  CHECK(packer.empty());
+  CHECK(!packer.needs_flush(0, KEY_A));
+  packer.add(0, KEY_A);
+  CHECK(!packer.needs_flush(0, KEY_B));
+  packer.add(0, KEY_B);
+  CHECK_EQ(packer.size(), uint8_t(2));
+  const uint8_t expected[8] = {0, 0, KEY_A, KEY_B, 0, 0, 0, 0};
+  CHECK(memcmp(packer.report(), expected, 8) == 0);
+}
+
+TEST_CASE(repeated_key_flushes) {
+  KeyReportPacker packer;
+  packer.add(0, KEY_A);
+  packer.add(0, KEY_B);
+  CHECK(packer.needs_flush(0, KEY_A));
+  CHECK(packer.needs_flush(0, KEY_B));
+  CHECK(!packer.needs_flush(0, KEY_C));
+}
+
+TEST_CASE(modifier_change_flushes) {
+  KeyReportPacker packer;
+  packer.add(KEY_MOD_LSHIFT, KEY_A);
+  CHECK(!packer.needs_flush(KEY_MOD_LSHIFT, KEY_B));
+  CHECK(packer.needs_flush(0, KEY_B));
+  CHECK(packer.needs_flush(KEY_MOD_RALT, KEY_B));
+}
+
+TEST_CASE(keys_per_report_limit_flushes) {
+  KeyReportPacker packer;
+  for (uint8_t i = 0; i < 6; i++) {
+    CHECK(!packer.needs_flush(0, KEY_A + i));
+    packer.add(0, KEY_A + i);
+  }
+  CHECK(packer.needs_flush(0, KEY_A + 6));
+
+  packer.clear();
+  packer.set_keys_per_report(1);
+  packer.add(0, KEY_A);
+  CHECK(packer.needs_flush(0, KEY_B));
+}
+
+TEST_CASE(clear_empties_the_report) {
+  KeyReportPacker packer;
+  packer.add(KEY_MOD_LSHIFT, KEY_A);
+  packer.clear();
+  CHECK(packer.empty());
+  CHECK(!packer.needs_flush(0, KEY_A));
+  const uint8_t zero[8] = {0};
+  CHECK(memcmp(packer.report(), zero, 8) == 0);
+}
+
+static const char *const CORPUS[] = {
+    "The quick brown fox jumps over the lazy dog.",
+    "Hello, World! 1234567890",
+    "ssh admin@192.168.1.10 -p 2222",
+    "https://example.com/path?query=value&x=1",
+    "Passw0rd!#$%^&*()_+-=[]{}|;':\",./<>?",
+    "aaaa bbbb cccc dddd eeee ffff gggg",
+    "Mississippi bookkeeper committee",
+};
+
+// Keyboard notifications needed to type the corpus; the text has to arrive intact
+static size_t notifications_for_corpus(uint8_t keys_per_report, size_t &chars) {
+  KeyboardHarness h;
+  h.kb().set_keys_per_report(keys_per_report);
+  h.start();
+  uint16_t conn = h.connect(1);
+  h.run_for(100);
+  std::string expected;
+  for (const char *line : CORPUS) {
+    h.kb().send_string(line);
+    CHECK(h.run_until_idle());
+    expected += line;
+  }
+  CHECK_EQ(h.typed_text(conn), expected);
+  chars = expected.size();
+  return h.reports(conn, KeyboardHarness::REPORT_KEYBOARD).size();
+}
+
+TEST_CASE(packing_cuts_notifications_on_a_corpus) {
+  size_t chars = 0;
+  size_t unpacked = notifications_for_corpus(1, chars);
+  size_t packed = notifications_for_corpus(6, chars);
+  printf("corpus of %zu chars: %zu notifications unpacked, %zu packed\n", chars, unpacked, packed);
+  // Unpacked is exactly one press and one release per character
+  CHECK_EQ(unpacked, 2 * chars);
+  CHECK_LT(packed * 2, unpacked);
+}